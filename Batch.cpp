@@ -0,0 +1,181 @@
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+
+#include "Batch.h"
+#include "JsonReader.h"
+#include "Text.h"
+
+// done
+Batch::Batch(Ntfs &ntfs, int input, int output)
+    : m_input(input),
+      m_shell(ntfs, m_shellInput, m_shellOutput),
+      m_writer(output, BATCH_WRITE_BUFFER_SIZE)
+{}
+
+// done
+void Batch::Run()
+{
+    std::string received;
+    char buffer[BATCH_READ_SIZE];
+
+    while (!m_shell.IsTerminated()) {
+        // flush the responses only when the client may be waiting for them
+        pollfd ready{m_input, POLLIN, 0};
+
+        if (poll(&ready, 1, 0) == 0) {
+            m_writer.Flush();
+        }
+
+        ssize_t count = read(m_input, buffer, sizeof(buffer));
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            break;
+        }
+
+        received.append(buffer, static_cast<size_t>(count));
+
+        size_t start = 0;
+
+        for (size_t end; (end = received.find('\n', start)) != std::string::npos; start = end + 1) {
+            HandleLine(received.substr(start, end - start));
+
+            if (m_shell.IsTerminated()) {
+                break;
+            }
+        }
+
+        received.erase(0, start);
+    }
+
+    // the last request may miss the newline
+    if (!m_shell.IsTerminated()) {
+        HandleLine(received);
+    }
+
+    m_writer.Flush();
+}
+
+// done
+void Batch::HandleLine(const std::string &line)
+{
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+        return;
+    }
+
+    std::string id{"null"};
+    std::string command;
+    std::string error;
+
+    try {
+        command = ParseRequest(line, id);
+    }
+    catch (BatchRequestException &exception) {
+        error = std::string{"bad request: "} + exception.what();
+    }
+
+    if (error.empty()) {
+        try {
+            if (!m_shell.Handle(command)) {
+                error = m_shell.GetError();
+            }
+        }
+        catch (std::exception &exception) {
+            error = std::string{"ERROR: "} + exception.what();
+        }
+    }
+
+    std::string response{"{\"id\":" + id + ",\"ok\":" + (error.empty() ? "true" : "false")};
+
+    if (!error.empty()) {
+        response += TextField("error", error);
+    }
+
+    response += TextField("output", m_shellOutput.str()) + "}\n";
+    m_shellOutput.str("");
+
+    m_writer.Write(response);
+}
+
+// done
+std::string Batch::TextField(const std::string &key, const std::string &text)
+{
+    if (Text::isUtf8(text)) {
+        return ",\"" + key + "\":" + Text::jsonQuote(text);
+    }
+
+    // the json strings can't hold the raw bytes, so they are sent encoded
+    return ",\"" + key + "_b64\":\"" + Text::base64(text) + "\"";
+}
+
+// done
+std::string Batch::ParseRequest(const std::string &line, std::string &id)
+{
+    JsonReader reader{line};
+    std::string command;
+    bool hasCommand{false};
+    std::string arguments;
+
+    reader.Expect('{');
+
+    if (!reader.Consume('}')) {
+        do {
+            std::string key = reader.ReadString();
+            reader.Expect(':');
+
+            if (key == "id") {
+                char next = reader.Peek();
+
+                if (next == '{' || next == '[') {
+                    throw BatchRequestException{"the id must be a string, number or null"};
+                }
+
+                id = reader.ReadRaw();
+            }
+            else if (key == "command") {
+                command = reader.ReadString();
+                hasCommand = true;
+            }
+            else if (key == "args") {
+                reader.Expect('[');
+
+                if (!reader.Consume(']')) {
+                    do {
+                        std::string argument = reader.ReadString();
+
+                        // the shell splits the line on whitespace, so an argument can't contain it
+                        if (argument.empty() || argument.find_first_of(" \t\n\r\v\f") != std::string::npos) {
+                            throw BatchRequestException{"the argument can't be empty or contain whitespace"};
+                        }
+
+                        arguments += " " + argument;
+                    } while (reader.Consume(','));
+
+                    reader.Expect(']');
+                }
+            }
+            else {
+                reader.SkipValue();
+            }
+        } while (reader.Consume(','));
+
+        reader.Expect('}');
+    }
+
+    reader.ExpectEnd();
+
+    if (!hasCommand) {
+        throw BatchRequestException{"the command is missing"};
+    }
+
+    if (command.find('\n') != std::string::npos) {
+        throw BatchRequestException{"the command can't contain a newline"};
+    }
+
+    return command + arguments;
+}
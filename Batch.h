@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+
+#include "Ntfs.h"
+#include "Shell.h"
+#include "BufferedWriter.h"
+
+/**
+ * Class Batch runs the shell commands given as the newline delimited json requests and writes the json responses.
+ * The request is an object {"id": <any>, "command": "<command line>", "args": ["<argument>", ...]},
+ * where the id and the args are optional and the args are appended to the command line.
+ * The response is an object {"id": <the request id>, "ok": <bool>, "error": "<message>", "output": "<shell output>"}
+ * on its own line, the error is present only if the command failed.
+ * The error or the output, which isn't valid utf-8 (e.g. the cat of a binary file), is sent base64 encoded
+ * in the "error_b64" or the "output_b64" field instead, so the bytes always round-trip.
+ * The commands run one by one in the order of the requests and the responses go in the same order,
+ * they are buffered and flushed only when the next read could block, so the pipelined clients
+ * don't wait for each response and the responses don't cost a write each.
+ */
+class Batch
+{
+public:
+    /**
+     * Initializes a new Batch of the ntfs.
+     *
+     * @param ntfs The ntfs which the commands operate on.
+     * @param input The file descriptor of the requests.
+     * @param output The file descriptor of the responses.
+     */
+    Batch(Ntfs &ntfs, int input, int output);
+
+    /**
+     * Handle the requests until the end of the input or the exit command.
+     *
+     * @throws BatchOutputException When the responses can't be written.
+     */
+    void Run();
+
+private:
+    /**
+     * The file descriptor of the requests.
+     */
+    int m_input;
+
+    /**
+     * The unused shell input.
+     */
+    std::istringstream m_shellInput;
+
+    /**
+     * The shell output of the running command.
+     */
+    std::ostringstream m_shellOutput;
+
+    /**
+     * The shell running the commands.
+     */
+    Shell m_shell;
+
+    /**
+     * The writer of the responses.
+     */
+    BufferedWriter m_writer;
+
+    /**
+     * Handle the request line and write its response, the blank lines are skipped.
+     *
+     * @param line The request line.
+     */
+    void HandleLine(const std::string &line);
+
+    /**
+     * Build the response field of the text, base64 encoded under the key with the _b64 suffix if it isn't utf-8.
+     *
+     * @param key The field name.
+     * @param text The text.
+     *
+     * @return The field preceded by the comma.
+     */
+    std::string TextField(const std::string &key, const std::string &text);
+
+    /**
+     * Parse the request into its id and command line.
+     *
+     * @param line The request line.
+     * @param id The raw json text of the request id, "null" if it isn't given.
+     *
+     * @throws BatchRequestException When the request isn't valid.
+     *
+     * @return The command line.
+     */
+    std::string ParseRequest(const std::string &line, std::string &id);
+};
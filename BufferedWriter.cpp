@@ -0,0 +1,57 @@
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+#include "BufferedWriter.h"
+
+// done
+BufferedWriter::BufferedWriter(int fd, size_t capacity)
+    : m_fd(fd),
+      m_capacity(capacity)
+{
+    m_buffer.reserve(m_capacity);
+}
+
+// done
+BufferedWriter::~BufferedWriter()
+{
+    try {
+        Flush();
+    }
+    catch (BatchOutputException &exception) {
+        // the output is gone, nothing to report it to
+    }
+}
+
+// done
+void BufferedWriter::Write(const std::string &data)
+{
+    m_buffer += data;
+
+    if (m_buffer.size() >= m_capacity) {
+        Flush();
+    }
+}
+
+// done
+void BufferedWriter::Flush()
+{
+    size_t written = 0;
+
+    while (written < m_buffer.size()) {
+        ssize_t count = write(m_fd, m_buffer.data() + written, m_buffer.size() - written);
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            m_buffer.clear();
+            throw BatchOutputException{"can't write the output: " + std::string{std::strerror(errno)}};
+        }
+
+        written += static_cast<size_t>(count);
+    }
+
+    m_buffer.clear();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+
+#include "Exceptions/BatchExceptions.h"
+
+/**
+ * Class BufferedWriter collects the written data and writes it to the file descriptor in large chunks,
+ * so the many small responses don't cost a system call each.
+ */
+class BufferedWriter
+{
+public:
+    /**
+     * Initializes a new BufferedWriter of the file descriptor.
+     *
+     * @param fd The file descriptor, it isn't closed by the writer.
+     * @param capacity The size of the buffer which is written when it is full.
+     */
+    BufferedWriter(int fd, size_t capacity);
+
+    /**
+     * Flush the buffered data, the errors are ignored.
+     */
+    ~BufferedWriter();
+
+    BufferedWriter(const BufferedWriter &) = delete;
+
+    BufferedWriter &operator=(const BufferedWriter &) = delete;
+
+    /**
+     * Append the data to the buffer and flush it when it is full.
+     *
+     * @param data The data.
+     *
+     * @throws BatchOutputException When the data can't be written.
+     */
+    void Write(const std::string &data);
+
+    /**
+     * Write all the buffered data to the file descriptor.
+     *
+     * @throws BatchOutputException When the data can't be written.
+     */
+    void Flush();
+
+private:
+    /**
+     * The file descriptor.
+     */
+    int m_fd;
+
+    /**
+     * The size of the buffer which is written when it is full.
+     */
+    size_t m_capacity;
+
+    /**
+     * The buffered data.
+     */
+    std::string m_buffer;
+};
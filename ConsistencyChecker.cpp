@@ -0,0 +1,717 @@
+#include <algorithm>
+#include <deque>
+#include <unordered_set>
+
+#include "ConsistencyChecker.h"
+#include "NodeInvariants.h"
+
+// done
+ConsistencyChecker::ConsistencyChecker(Ntfs &ntfs, std::ostream &output)
+    : m_ntfs(ntfs),
+      m_output(output),
+      m_problemCount{0}
+{}
+
+// done
+bool ConsistencyChecker::Run()
+{
+    m_problemCount = 0;
+    m_nodes.clear();
+    m_children.clear();
+    m_parents.clear();
+    m_leakedRuns.clear();
+    m_orphans.clear();
+    m_sizeMismatches.clear();
+    m_multiLinked.clear();
+    m_unmarkedRuns.clear();
+    m_badEntries.clear();
+    m_owners.assign(static_cast<size_t>(m_ntfs.m_partition.GetClusterCount()), UID_ITEM_FREE);
+    m_sharedRuns.clear();
+
+    ScanMft();
+    ReportSharedClusters();
+    CheckNodes();
+    CheckBitmap();
+    CheckDirectoryTree();
+
+    m_output
+        << "nodes: " << m_nodes.size()
+        << ", problems: " << m_problemCount
+        << std::endl;
+
+    return m_problemCount == 0;
+}
+
+// done
+void ConsistencyChecker::ScanMft()
+{
+    int32_t mftItemCount = m_ntfs.m_partition.GetMftItemCount();
+
+    for (int32_t start = 0; start < mftItemCount; start += MFT_READ_CHUNK_SIZE) {
+        auto chunk = m_ntfs.m_partition.ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
+
+        for (auto &mftItem : chunk) {
+            if (mftItem.item.uid != UID_ITEM_FREE) {
+                AddItem(mftItem.item);
+            }
+        }
+    }
+}
+
+// done
+void ConsistencyChecker::AddItem(const mft_item &item)
+{
+    auto inserted = m_nodes.emplace(item.uid, NodeInfo{false, false, 0, 0, 0, 0, {}});
+    NodeInfo &node = inserted.first->second;
+
+    node.itemCount++;
+
+    if (item.order == 0) {
+        node.hasFirstItem = true;
+        node.isDirectory = item.is_directory;
+        node.size = item.size;
+        node.expectedItemCount = item.count;
+    }
+
+    ScanFragments(item, node);
+}
+
+// done
+void ConsistencyChecker::ScanFragments(const mft_item &item, NodeInfo &node)
+{
+    int32_t clusterCount = m_ntfs.m_partition.GetClusterCount();
+
+    for (int i = 0; i < MFT_FRAGMENTS_COUNT && item.fragments[i].start != FRAGMENT_UNUSED_START; i++) {
+        const mft_fragment &fragment = item.fragments[i];
+
+        if (!NodeInvariants::IsFragmentInBounds(fragment, clusterCount)) {
+            Warn("WARNING: the node " + std::to_string(item.uid)
+                     + " has the fragment [start=" + std::to_string(fragment.start)
+                     + ", count=" + std::to_string(fragment.count) + "] out of the data segment");
+            continue;
+        }
+
+        for (int32_t cluster = fragment.start; cluster < fragment.start + fragment.count; cluster++) {
+            if (m_owners[cluster] == UID_ITEM_FREE) {
+                m_owners[cluster] = item.uid;
+            } else {
+                AddToRuns(m_sharedRuns[std::make_pair(m_owners[cluster], item.uid)], cluster);
+            }
+        }
+
+        node.clusterCount += fragment.count;
+
+        if (item.is_directory) {
+            node.extents.emplace_back(item.order, fragment);
+        }
+    }
+}
+
+// done
+void ConsistencyChecker::ReportSharedClusters()
+{
+    for (auto &entry : m_sharedRuns) {
+        auto &runs = entry.second;
+
+        // the fragments of the other owner needn't be in the cluster order, join the touching runs
+        std::sort(runs.begin(), runs.end(), [](const mft_fragment &run1, const mft_fragment &run2) {
+            return run1.start < run2.start;
+        });
+
+        std::vector<mft_fragment> joined;
+
+        for (auto &run : runs) {
+            if (!joined.empty() && run.start <= joined.back().start + joined.back().count) {
+                joined.back().count = std::max(joined.back().count, run.start + run.count - joined.back().start);
+            } else {
+                joined.push_back(run);
+            }
+        }
+
+        for (auto &run : joined) {
+            Warn("WARNING: the clusters [start=" + std::to_string(run.start)
+                     + ", count=" + std::to_string(run.count) + "] are owned by the node "
+                     + std::to_string(entry.first.first) + " and the node " + std::to_string(entry.first.second));
+        }
+    }
+}
+
+// done
+void ConsistencyChecker::CheckNodes()
+{
+    int32_t clusterSize = m_ntfs.m_partition.GetClusterSize();
+
+    for (auto &entry : m_nodes) {
+        int32_t uid = entry.first;
+        const NodeInfo &node = entry.second;
+
+        if (!node.hasFirstItem || node.itemCount != node.expectedItemCount) {
+            Warn("WARNING: the node " + std::to_string(uid)
+                     + " has " + std::to_string(node.itemCount) + " mft items"
+                     + (node.hasFirstItem ? " instead of " + std::to_string(node.expectedItemCount)
+                                          : " without the first one"));
+            continue;
+        }
+
+        if (NodeInvariants::CompareClustersWithSize(node.clusterCount, node.size, clusterSize) != 0) {
+            Warn("WARNING: the node " + std::to_string(uid)
+                     + " has " + std::to_string(node.clusterCount) + " clusters"
+                     + " - not corresponding with the node size " + std::to_string(node.size) + " bytes");
+            m_sizeMismatches.push_back(uid);
+        }
+    }
+}
+
+// done
+void ConsistencyChecker::CheckBitmap()
+{
+    auto bitmap = m_ntfs.m_partition.ReadBitmap();
+
+    for (size_t cluster = 0; cluster < bitmap.size(); cluster++) {
+        bool used = bitmap[cluster] != BIT_CLUSTER_FREE;
+
+        if (m_owners[cluster] != UID_ITEM_FREE && !used) {
+            Warn("WARNING: the cluster " + std::to_string(cluster) + " is owned by a node but marked as free");
+            AddToRuns(m_unmarkedRuns, static_cast<int32_t>(cluster));
+        }
+        else if (m_owners[cluster] == UID_ITEM_FREE && used) {
+            AddToRuns(m_leakedRuns, static_cast<int32_t>(cluster));
+        }
+    }
+
+    for (auto &run : m_leakedRuns) {
+        Warn("WARNING: the clusters [start=" + std::to_string(run.start)
+                 + ", count=" + std::to_string(run.count) + "] are marked as used but owned by no node");
+    }
+}
+
+// done
+void ConsistencyChecker::CheckDirectoryTree()
+{
+    // read every directory once
+    for (auto &entry : m_nodes) {
+        if (!entry.second.hasFirstItem || !entry.second.isDirectory) {
+            continue;
+        }
+
+        auto uids = ReadDirectory(entry.second);
+
+        // skip parent
+        for (size_t i = 1; i < uids.size(); i++) {
+            if (m_nodes.find(uids[i]) == m_nodes.end()) {
+                Warn("WARNING: the directory " + std::to_string(entry.first)
+                         + " contains the node " + std::to_string(uids[i]) + " which doesn't exist");
+                m_badEntries[entry.first].push_back(uids[i]);
+                continue;
+            }
+
+            m_children[entry.first].push_back(uids[i]);
+            m_parents[uids[i]].push_back(entry.first);
+        }
+    }
+
+    // go through the tree from the root
+    std::unordered_set<int32_t> reachable;
+    std::deque<int32_t> queue;
+
+    if (m_nodes.find(UID_ROOT) != m_nodes.end()) {
+        reachable.insert(UID_ROOT);
+        queue.push_back(UID_ROOT);
+    }
+
+    while (!queue.empty()) {
+        int32_t uid = queue.front();
+        queue.pop_front();
+
+        for (auto &child : m_children[uid]) {
+            if (reachable.insert(child).second) {
+                queue.push_back(child);
+            }
+        }
+    }
+
+    for (auto &entry : m_nodes) {
+        int32_t uid = entry.first;
+
+        if (reachable.find(uid) == reachable.end()) {
+            Warn("WARNING: the node " + std::to_string(uid) + " is not reachable from the directory structure");
+            m_orphans.push_back(uid);
+        }
+
+        auto parents = m_parents.find(uid);
+
+        if (parents != m_parents.end() && parents->second.size() > 1) {
+            Warn("WARNING: the node " + std::to_string(uid) + " is present in multiple directories");
+            m_multiLinked.push_back(uid);
+
+            // keep the entry in the first reachable directory, the others are bad
+            auto kept = std::find_if(parents->second.begin(), parents->second.end(), [&reachable](int32_t parent) {
+                return reachable.find(parent) != reachable.end();
+            });
+
+            if (kept == parents->second.end()) {
+                kept = parents->second.begin();
+            }
+
+            for (auto itParent = parents->second.begin(); itParent != parents->second.end(); itParent++) {
+                if (itParent != kept) {
+                    m_badEntries[*itParent].push_back(uid);
+                }
+            }
+        }
+    }
+}
+
+// done
+std::vector<int32_t> ConsistencyChecker::ReadDirectory(const NodeInfo &node)
+{
+    auto extents = node.extents;
+
+    std::stable_sort(extents.begin(), extents.end(), [](const std::pair<int8_t, mft_fragment> &extent1,
+                                                        const std::pair<int8_t, mft_fragment> &extent2) {
+        return extent1.first < extent2.first;
+    });
+
+    size_t clusterSize = static_cast<size_t>(m_ntfs.m_partition.GetClusterSize());
+
+    std::vector<int32_t> uids;
+    uids.resize(std::min(static_cast<size_t>(std::max(node.size, 0)), node.clusterCount * clusterSize) / sizeof(int32_t));
+
+    auto destination = reinterpret_cast<char *>(uids.data());
+    auto remaining = uids.size() * sizeof(int32_t);
+
+    for (auto &extent : extents) {
+        if (remaining == 0) {
+            break;
+        }
+
+        size_t toRead = std::min(remaining, extent.second.count * clusterSize);
+        m_ntfs.m_partition.ReadClusterRun(extent.second.start, 0, destination, toRead);
+
+        destination += toRead;
+        remaining -= toRead;
+    }
+
+    return uids;
+}
+
+// done
+bool ConsistencyChecker::RunIncremental()
+{
+    const DirtyMap &dirtyMap = m_ntfs.m_partition.GetDirtyMap();
+
+    if (!dirtyMap.IsComplete()) {
+        m_output << "the changes since the last check are unknown - running the full check" << std::endl;
+        return Run();
+    }
+
+    m_problemCount = 0;
+    m_nodes.clear();
+    m_owners.assign(static_cast<size_t>(m_ntfs.m_partition.GetClusterCount()), UID_ITEM_FREE);
+    m_sharedRuns.clear();
+
+    ScanDirtyItems(dirtyMap);
+    ReportSharedClusters();
+    CheckNodes();
+    CheckOwnedClusters();
+    CheckDirtyDirectories(dirtyMap);
+
+    m_output
+        << "touched nodes: " << m_nodes.size()
+        << ", problems: " << m_problemCount
+        << std::endl;
+
+    return m_problemCount == 0;
+}
+
+// done
+void ConsistencyChecker::ScanDirtyItems(const DirtyMap &dirtyMap)
+{
+    std::unordered_map<int32_t, std::vector<mft_item>> items;
+
+    for (auto &index : dirtyMap.GetMftItems()) {
+        MftItem mftItem = m_ntfs.m_partition.ReadMftItem(index);
+
+        if (mftItem.item.uid != UID_ITEM_FREE) {
+            items[mftItem.item.uid].push_back(mftItem.item);
+        }
+    }
+
+    // the nodes which mft items weren't all touched and the touched directories which mft items weren't
+    std::unordered_set<int32_t> missing;
+
+    for (auto &entry : items) {
+        auto first = std::find_if(entry.second.begin(), entry.second.end(), [](const mft_item &item) {
+            return item.order == 0;
+        });
+
+        if (first == entry.second.end() || first->count != static_cast<int32_t>(entry.second.size())) {
+            missing.insert(entry.first);
+        }
+    }
+
+    for (auto &uid : dirtyMap.GetDirectories()) {
+        if (items.find(uid) == items.end() && dirtyMap.GetReleased().find(uid) == dirtyMap.GetReleased().end()) {
+            missing.insert(uid);
+        }
+    }
+
+    if (!missing.empty()) {
+        for (auto &uid : missing) {
+            items[uid].clear();
+        }
+
+        int32_t mftItemCount = m_ntfs.m_partition.GetMftItemCount();
+
+        for (int32_t start = 0; start < mftItemCount; start += MFT_READ_CHUNK_SIZE) {
+            auto chunk = m_ntfs.m_partition.ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
+
+            for (auto &mftItem : chunk) {
+                if (missing.find(mftItem.item.uid) != missing.end()) {
+                    items[mftItem.item.uid].push_back(mftItem.item);
+                }
+            }
+        }
+    }
+
+    for (auto &entry : items) {
+        for (auto &item : entry.second) {
+            AddItem(item);
+        }
+    }
+}
+
+// done
+void ConsistencyChecker::CheckOwnedClusters()
+{
+    auto bitmap = m_ntfs.m_partition.ReadBitmap();
+
+    for (size_t cluster = 0; cluster < bitmap.size(); cluster++) {
+        if (m_owners[cluster] != UID_ITEM_FREE && bitmap[cluster] == BIT_CLUSTER_FREE) {
+            Warn("WARNING: the cluster " + std::to_string(cluster) + " is owned by a node but marked as free");
+        }
+    }
+}
+
+// done
+void ConsistencyChecker::CheckDirtyDirectories(const DirtyMap &dirtyMap)
+{
+    const auto &released = dirtyMap.GetReleased();
+    std::unordered_map<int32_t, int32_t> linkCounts;
+
+    for (auto &uid : dirtyMap.GetDirectories()) {
+        auto found = m_nodes.find(uid);
+
+        if (found == m_nodes.end() || !found->second.hasFirstItem) {
+            // the directory was released
+            continue;
+        }
+
+        if (!found->second.isDirectory) {
+            Warn("WARNING: the node " + std::to_string(uid) + " is used as a directory but it is a file");
+            continue;
+        }
+
+        auto uids = ReadDirectory(found->second);
+
+        // skip parent
+        for (size_t i = 1; i < uids.size(); i++) {
+            if (m_nodes.find(uids[i]) == m_nodes.end() && released.find(uids[i]) != released.end()) {
+                Warn("WARNING: the directory " + std::to_string(uid)
+                         + " contains the node " + std::to_string(uids[i]) + " which doesn't exist");
+                continue;
+            }
+
+            linkCounts[uids[i]]++;
+        }
+    }
+
+    for (auto &uid : dirtyMap.GetRelinked()) {
+        bool exists = m_nodes.find(uid) != m_nodes.end() || released.find(uid) == released.end();
+
+        if (!exists || uid == UID_ROOT) {
+            continue;
+        }
+
+        auto links = linkCounts.find(uid);
+
+        if (links == linkCounts.end()) {
+            Warn("WARNING: the node " + std::to_string(uid) + " is not reachable from the directory structure");
+        }
+        else if (links->second > 1) {
+            Warn("WARNING: the node " + std::to_string(uid) + " is present in multiple directories");
+        }
+    }
+}
+
+// done
+void ConsistencyChecker::Repair()
+{
+    // the repair writes the mft directly, only the next full check can be trusted
+    m_ntfs.m_partition.GetDirtyMap().Invalidate();
+
+    // mark the owned clusters first, so they can't be allocated while the directories are rewritten
+    for (auto &run : m_unmarkedRuns) {
+        m_ntfs.m_partition.WriteBitmapRun(run.start, run.count, true);
+    }
+
+    RepairDirectories();
+    RepairNodes();
+    RebuildBitmap();
+
+    // the open files may refer to the changed nodes
+    std::lock_guard<std::mutex> lock{m_ntfs.m_openFilesMutex};
+    m_ntfs.m_openFiles.clear();
+}
+
+// done
+void ConsistencyChecker::RepairDirectories()
+{
+    std::unordered_set<int32_t> orphans{m_orphans.begin(), m_orphans.end()};
+
+    for (auto &entry : m_badEntries) {
+        if (orphans.find(entry.first) != orphans.end()) {
+            // the orphan directory is released as whole
+            continue;
+        }
+
+        Node directory = m_ntfs.m_nodeManager.FindNode(entry.first, true);
+        auto uids = m_ntfs.ReadDirectoryUids(directory);
+
+        // remove one entry for every bad one, the parent entry is kept
+        for (auto &badUid : entry.second) {
+            auto found = std::find(uids.begin() + 1, uids.end(), badUid);
+
+            if (found != uids.end()) {
+                uids.erase(found);
+            }
+        }
+
+        m_ntfs.m_nodeManager.ResizeNode(directory, static_cast<int32_t>(uids.size() * sizeof(int32_t)));
+        m_ntfs.m_nodeManager.WriteIntoNode(directory, uids.data());
+
+        m_output
+            << "REPAIRED: removed " << entry.second.size()
+            << " entries from the directory " << entry.first
+            << std::endl;
+    }
+}
+
+// done
+void ConsistencyChecker::RepairNodes()
+{
+    std::unordered_set<int32_t> orphans{m_orphans.begin(), m_orphans.end()};
+    std::unordered_set<int32_t> mismatched{m_sizeMismatches.begin(), m_sizeMismatches.end()};
+    std::unordered_map<int32_t, std::vector<MftItem>> mismatchedItems;
+    std::vector<MftItem> changed;
+
+    int32_t mftItemCount = m_ntfs.m_partition.GetMftItemCount();
+
+    for (int32_t start = 0; start < mftItemCount; start += MFT_READ_CHUNK_SIZE) {
+        auto chunk = m_ntfs.m_partition.ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
+
+        for (auto &item : chunk) {
+            if (item.item.uid == UID_ITEM_FREE) {
+                continue;
+            }
+
+            if (item.item.uid != UID_ROOT && orphans.find(item.item.uid) != orphans.end()) {
+                // release the orphan mft item
+                MftItem freeItem{};
+                freeItem.index = item.index;
+                freeItem.item.uid = UID_ITEM_FREE;
+
+                changed.push_back(freeItem);
+            }
+            else if (mismatched.find(item.item.uid) != mismatched.end()) {
+                mismatchedItems[item.item.uid].push_back(item);
+            }
+        }
+    }
+
+    size_t fixedCount{0};
+
+    for (auto &entry : mismatchedItems) {
+        std::sort(entry.second.begin(), entry.second.end(), [](const MftItem &item1, const MftItem &item2) {
+            return item1.item.order < item2.item.order;
+        });
+
+        if (RepairNodeSize(entry.second, changed)) {
+            fixedCount++;
+        }
+    }
+
+    m_ntfs.m_partition.WriteMftItems(changed);
+
+    if (!m_orphans.empty()) {
+        m_output << "REPAIRED: released " << m_orphans.size() << " orphan nodes" << std::endl;
+    }
+
+    if (fixedCount > 0) {
+        m_output << "REPAIRED: fixed the size of " << fixedCount << " nodes" << std::endl;
+    }
+}
+
+// done
+bool ConsistencyChecker::RepairNodeSize(std::vector<MftItem> &items, std::vector<MftItem> &changed)
+{
+    int32_t clusterSize = m_ntfs.m_partition.GetClusterSize();
+    int32_t partitionClusters = m_ntfs.m_partition.GetClusterCount();
+    mft_item &first = items.front().item;
+    int32_t clusterCount{0};
+
+    for (auto &item : items) {
+        for (int i = 0; i < MFT_FRAGMENTS_COUNT && item.item.fragments[i].start != FRAGMENT_UNUSED_START; i++) {
+            const mft_fragment &fragment = item.item.fragments[i];
+
+            if (NodeInvariants::IsFragmentInBounds(fragment, partitionClusters)) {
+                clusterCount += fragment.count;
+            }
+        }
+    }
+
+    if (clusterCount == 0) {
+        // there are no clusters to keep, the node is empty
+        for (auto &item : items) {
+            item.item.size = 0;
+        }
+
+        changed.insert(changed.end(), items.begin(), items.end());
+        return true;
+    }
+
+    int comparison = NodeInvariants::CompareClustersWithSize(clusterCount, first.size, clusterSize);
+
+    if (comparison == 0) {
+        // the directory repair has already fixed the node
+        return false;
+    }
+
+    if (comparison < 0) {
+        // too few clusters - cut the size to their capacity
+        first.size = clusterCount * clusterSize;
+
+        for (auto &item : items) {
+            item.item.size = first.size;
+        }
+
+        changed.insert(changed.end(), items.begin(), items.end());
+        return true;
+    }
+
+    // too many clusters - cut the fragments behind the clusters needed for the size
+    int32_t toKeep = first.size / clusterSize + 1;
+    int32_t keptItems{0};
+
+    for (auto &item : items) {
+        for (int i = 0; i < MFT_FRAGMENTS_COUNT && item.item.fragments[i].start != FRAGMENT_UNUSED_START; i++) {
+            mft_fragment &fragment = item.item.fragments[i];
+
+            if (toKeep == 0) {
+                fragment.start = FRAGMENT_UNUSED_START;
+                fragment.count = 0;
+                continue;
+            }
+
+            fragment.count = std::min(fragment.count, toKeep);
+            toKeep -= fragment.count;
+        }
+
+        if (item.item.fragments[0].start != FRAGMENT_UNUSED_START) {
+            keptItems++;
+        }
+    }
+
+    // release the emptied mft items and update the item count of the others
+    for (auto &item : items) {
+        if (item.item.order < keptItems) {
+            item.item.count = static_cast<int8_t>(keptItems);
+        } else {
+            item.item = mft_item{};
+            item.item.uid = UID_ITEM_FREE;
+        }
+    }
+
+    changed.insert(changed.end(), items.begin(), items.end());
+
+    return true;
+}
+
+// done
+void ConsistencyChecker::RebuildBitmap()
+{
+    // collect the clusters owned by the remaining nodes
+    std::vector<bool> owned(static_cast<size_t>(m_ntfs.m_partition.GetClusterCount()), false);
+    int32_t mftItemCount = m_ntfs.m_partition.GetMftItemCount();
+
+    for (int32_t start = 0; start < mftItemCount; start += MFT_READ_CHUNK_SIZE) {
+        auto chunk = m_ntfs.m_partition.ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
+
+        for (auto &mftItem : chunk) {
+            const mft_item &item = mftItem.item;
+
+            if (item.uid == UID_ITEM_FREE) {
+                continue;
+            }
+
+            for (int i = 0; i < MFT_FRAGMENTS_COUNT && item.fragments[i].start != FRAGMENT_UNUSED_START; i++) {
+                const mft_fragment &fragment = item.fragments[i];
+
+                if (!NodeInvariants::IsFragmentInBounds(fragment, static_cast<int32_t>(owned.size()))) {
+                    continue;
+                }
+
+                std::fill(owned.begin() + fragment.start, owned.begin() + fragment.start + fragment.count, true);
+            }
+        }
+    }
+
+    // write only the runs, which differ from the bitmap
+    auto bitmap = m_ntfs.m_partition.ReadBitmap();
+    std::vector<mft_fragment> toSet;
+    std::vector<mft_fragment> toClear;
+
+    for (size_t cluster = 0; cluster < bitmap.size(); cluster++) {
+        bool used = bitmap[cluster] != BIT_CLUSTER_FREE;
+
+        if (owned[cluster] && !used) {
+            AddToRuns(toSet, static_cast<int32_t>(cluster));
+        }
+        else if (!owned[cluster] && used) {
+            AddToRuns(toClear, static_cast<int32_t>(cluster));
+        }
+    }
+
+    int32_t reclaimed{0};
+
+    for (auto &run : toSet) {
+        m_ntfs.m_partition.WriteBitmapRun(run.start, run.count, true);
+    }
+
+    for (auto &run : toClear) {
+        m_ntfs.m_partition.WriteBitmapRun(run.start, run.count, false);
+        reclaimed += run.count;
+    }
+
+    if (reclaimed > 0) {
+        m_output << "REPAIRED: reclaimed " << reclaimed << " clusters" << std::endl;
+    }
+}
+
+// done
+void ConsistencyChecker::AddToRuns(std::vector<mft_fragment> &runs, int32_t cluster)
+{
+    // join the consecutive clusters into one run
+    if (!runs.empty() && runs.back().start + runs.back().count == cluster) {
+        runs.back().count++;
+    } else {
+        runs.push_back(mft_fragment{cluster, 1});
+    }
+}
+
+// done
+void ConsistencyChecker::Warn(const std::string &message)
+{
+    m_output << message << std::endl;
+    m_problemCount++;
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+#include "Ntfs.h"
+
+/**
+ * The class ConsistencyChecker contains a logic for the full ntfs consistency check.
+ * It reads the bitmap and the mft only once, builds the map of the clusters
+ * owned by the nodes and cross-validates it with the bitmap.
+ * Then it reads the directories and checks the directory tree.
+ */
+class ConsistencyChecker
+{
+public:
+    /**
+     * Initializes a new ConsistencyChecker.
+     *
+     * @param ntfs The ntfs which the consistency checker will operate.
+     * @param output The output to print messages.
+     */
+    ConsistencyChecker(Ntfs &ntfs, std::ostream &output);
+
+    /**
+     * Run the full consistency check.
+     * Reports the clusters marked as used but owned by no node (leaks),
+     * the clusters owned by a node but marked as free, the clusters owned by multiple nodes,
+     * the fragments out of the data segment, the nodes with missing mft items,
+     * the nodes not reachable from the root (orphans), the nodes present in multiple directories,
+     * the directory entries of missing nodes and the nodes which size doesn't
+     * correspond with the number of their clusters.
+     *
+     * @return True if everything is OK, false otherwise.
+     */
+    bool Run();
+
+    /**
+     * Repair the problems found by the last run.
+     * The clusters owned by nodes are marked as used, the duplicate and dangling
+     * directory entries are removed (one rewrite per directory), the orphan nodes
+     * are released and the node sizes are fixed against their clusters
+     * (all in one pass over the mft), and finally the bitmap is rebuilt
+     * from the clusters owned by the remaining nodes, which reclaims the leaked clusters.
+     * The clusters owned by multiple nodes are not repaired.
+     * The partition dirty map is invalidated.
+     */
+    void Repair();
+
+    /**
+     * Run the incremental consistency check of the changes kept in the partition dirty map.
+     * Only the touched nodes are checked for their mft items, size and clusters marked in the bitmap,
+     * only the touched directories are checked for entries of the released nodes
+     * and the relinked nodes are checked to be present in some touched directory.
+     * The leaked clusters are found only by the full check.
+     * If the dirty map is incomplete, the full check is run instead.
+     *
+     * @return True if everything is OK, false otherwise.
+     */
+    bool RunIncremental();
+
+private:
+    /**
+     * The structure of the node properties collected from its mft items.
+     */
+    struct NodeInfo
+    {
+        bool hasFirstItem;                              // whether the first mft item was found
+        bool isDirectory;                               // the node type taken from the first mft item
+        int32_t size;                                   // the node size taken from the first mft item
+        int32_t itemCount;                              // the number of mft items found
+        int32_t expectedItemCount;                      // the number of mft items stated by the first mft item
+        int32_t clusterCount;                           // the number of clusters in the valid fragments
+        std::vector<std::pair<int8_t, mft_fragment>> extents; // the valid fragments with the order of their mft items, kept for directories
+    };
+
+    /**
+     * The ntfs which this checker operates on.
+     */
+    Ntfs &m_ntfs;
+
+    /**
+     * The output to print messages.
+     */
+    std::ostream &m_output;
+
+    /**
+     * The properties of the nodes by their uids.
+     */
+    std::unordered_map<int32_t, NodeInfo> m_nodes;
+
+    /**
+     * The child uids of the directories by the directory uids.
+     */
+    std::unordered_map<int32_t, std::vector<int32_t>> m_children;
+
+    /**
+     * The uids of the directories containing the node by the node uids.
+     */
+    std::unordered_map<int32_t, std::vector<int32_t>> m_parents;
+
+    /**
+     * The cluster ownership, the uid of the first node owning the cluster or UID_ITEM_FREE.
+     */
+    std::vector<int32_t> m_owners;
+
+    /**
+     * The runs of clusters owned by multiple nodes by the uids of the first and the other owner.
+     */
+    std::map<std::pair<int32_t, int32_t>, std::vector<mft_fragment>> m_sharedRuns;
+
+    /**
+     * The runs of clusters marked as used but owned by no node.
+     */
+    std::vector<mft_fragment> m_leakedRuns;
+
+    /**
+     * The uids of the nodes not reachable from the root directory.
+     */
+    std::vector<int32_t> m_orphans;
+
+    /**
+     * The uids of the nodes which size doesn't correspond with their clusters.
+     */
+    std::vector<int32_t> m_sizeMismatches;
+
+    /**
+     * The uids of the nodes present in multiple directories.
+     */
+    std::vector<int32_t> m_multiLinked;
+
+    /**
+     * The runs of clusters owned by some node but marked as free.
+     */
+    std::vector<mft_fragment> m_unmarkedRuns;
+
+    /**
+     * The directory entries to be removed, the uids of the entries by the directory uids.
+     */
+    std::unordered_map<int32_t, std::vector<int32_t>> m_badEntries;
+
+    /**
+     * The number of problems found.
+     */
+    int32_t m_problemCount;
+
+    /**
+     * Read the mft in chunks, collect the node properties and the cluster ownership.
+     */
+    void ScanMft();
+
+    /**
+     * Add the mft item to the properties of its node and collect the cluster ownership.
+     *
+     * @param item The mft item.
+     */
+    void AddItem(const mft_item &item);
+
+    /**
+     * Read the touched mft items and collect all the mft items of their nodes.
+     * The mft is read only when a touched node or directory has some mft items which weren't touched.
+     *
+     * @param dirtyMap The dirty map.
+     */
+    void ScanDirtyItems(const DirtyMap &dirtyMap);
+
+    /**
+     * Check that the clusters owned by the collected nodes are marked as used in the bitmap.
+     */
+    void CheckOwnedClusters();
+
+    /**
+     * Check the entries of the touched directories and the presence of the relinked nodes in them.
+     *
+     * @param dirtyMap The dirty map.
+     */
+    void CheckDirtyDirectories(const DirtyMap &dirtyMap);
+
+    /**
+     * Account the fragments of one mft item.
+     *
+     * @param item The mft item.
+     * @param node The properties of the item node.
+     */
+    void ScanFragments(const mft_item &item, NodeInfo &node);
+
+    /**
+     * Print one warning for every run of clusters owned by the same pair of nodes.
+     */
+    void ReportSharedClusters();
+
+    /**
+     * Check the mft items and the size of every node.
+     */
+    void CheckNodes();
+
+    /**
+     * Compare the cluster ownership with the bitmap.
+     */
+    void CheckBitmap();
+
+    /**
+     * Read the directories and check that every node is reachable exactly once.
+     */
+    void CheckDirectoryTree();
+
+    /**
+     * Read the uids of the directory child nodes.
+     *
+     * @param node The properties of the directory.
+     *
+     * @return The uids, the first one is the uid of the parent directory.
+     */
+    std::vector<int32_t> ReadDirectory(const NodeInfo &node);
+
+    /**
+     * Remove the bad entries from the directories, each directory is rewritten once.
+     */
+    void RepairDirectories();
+
+    /**
+     * Release the orphan nodes and fix the node sizes in one pass over the mft.
+     * The changed mft items are written at once.
+     */
+    void RepairNodes();
+
+    /**
+     * Fix the size of the node or cut its clusters, so they correspond to each other.
+     * The clusters are counted from the given items, as the directory repair may have resized the node.
+     *
+     * @param items The node mft items sorted by their order, the changed ones are appended to the changed items.
+     * @param changed The changed mft items.
+     *
+     * @return True if the node was fixed, false if its size already corresponds to its clusters.
+     */
+    bool RepairNodeSize(std::vector<MftItem> &items, std::vector<MftItem> &changed);
+
+    /**
+     * Scan the mft again and write the clusters ownership into the bitmap.
+     * Only the runs of differing bits are written.
+     */
+    void RebuildBitmap();
+
+    /**
+     * Add the cluster into the runs of clusters.
+     *
+     * @param runs The runs.
+     * @param cluster The cluster index.
+     */
+    void AddToRuns(std::vector<mft_fragment> &runs, int32_t cluster);
+
+    /**
+     * Print the warning and count the problem.
+     *
+     * @param message The message.
+     */
+    void Warn(const std::string &message);
+};
@@ -1,7 +1,8 @@
-#include <thread>
-#include <unordered_map>
-#include <unordered_set>
+#include <algorithm>
+#include <sstream>
+
 #include "DirectoryTreeChecker.h"
+#include "Exceptions/AppException.h"
 
 // done
 DirectoryTreeChecker::DirectoryTreeChecker(Ntfs &ntfs, std::ostream &output)
@@ -12,68 +13,41 @@ DirectoryTreeChecker::DirectoryTreeChecker(Ntfs &ntfs, std::ostream &output)
 // done
 bool DirectoryTreeChecker::Run()
 {
-    bool success = true;
-
-    std::unordered_set<int32_t> nodesReachable;
-    std::unordered_set<int32_t> nodesReachableMultipleTimes;
-
-    // go through the directory tree and remember node occurrences
-    std::vector<Node> nodeStack;
-
-    Node root = m_ntfs.m_nodeManager.FindNode(UID_ROOT);
-    nodeStack.emplace_back(root);
-
-    while (!nodeStack.empty()) {
-        Node node = std::move(nodeStack.back());
-        nodeStack.pop_back();
-
-        auto found = nodesReachable.find(node.GetUid());
-
-        if (found == nodesReachable.end()) {
-            nodesReachable.emplace(node.GetUid());
-        } else {
-            nodesReachableMultipleTimes.emplace(node.GetUid());
-            continue;
-        }
+    LoadMft();
 
-        if (!node.IsDirectory()) {
-            continue;
-        }
-
-        auto items = m_ntfs.GetDirectoryContents(node);
+    m_success = true;
+    m_pending = 0;
+    m_visits.reset(new std::atomic<int32_t>[m_mft.size()]);
 
-        // skip parent
-        items.pop_front();
-
-        for (auto &item : items) {
-            nodeStack.emplace_back(std::move(item));
-        }
+    for (size_t i = 0; i < m_mft.size(); i++) {
+        m_visits[i] = 0;
     }
 
-    // scan every file in partition an check if it is present in exactly one directory
-    std::unordered_set<int32_t> checkedNodes;
+    // go through the directory tree from the root and count the node visits
+    QueueNode(UID_ROOT, UID_ROOT);
 
-    for (int i = 0; i < m_ntfs.m_partition.GetMftItemCount(); ++i) {
-        MftItem item = m_ntfs.m_partition.ReadMftItem(i);
+    m_ntfs.m_threadPool.WaitUntil([this]() {
+        return m_pending == 0;
+    });
 
-        if (item.item.uid == UID_ITEM_FREE) {
-            continue;
-        }
+    bool success = m_success;
 
-        if (checkedNodes.find(item.item.uid) != checkedNodes.end()) {
+    // scan every node on the partition and check if it is present in exactly one directory
+    for (auto &item : m_mft) {
+        if (item.item.uid == UID_ITEM_FREE || item.item.order != 0) {
             continue;
         }
 
-        checkedNodes.emplace(item.item.uid);
+        int32_t visits = m_visits[item.index];
 
-        if (nodesReachable.find(item.item.uid) == nodesReachable.end()) {
+        if (visits == 0) {
             success = false;
             m_output
                 << "WARNING: the node " << item.item.uid
                 << " is not reachable from the directory structure"
                 << std::endl;
         }
-        else if (nodesReachableMultipleTimes.find(item.item.uid) != nodesReachableMultipleTimes.end()){
+        else if (visits > 1) {
             success = false;
             m_output
                 << "WARNING: the node " << item.item.uid
@@ -82,5 +56,132 @@ bool DirectoryTreeChecker::Run()
         }
     }
 
+    m_mft.clear();
+    m_nodeItems.clear();
+    m_visits.reset();
+
     return success;
 }
+
+// done
+void DirectoryTreeChecker::LoadMft()
+{
+    m_mft = m_ntfs.m_partition.ReadMftRange(0, m_ntfs.m_partition.GetMftItemCount());
+    m_nodeItems.clear();
+
+    for (auto &item : m_mft) {
+        if (item.item.uid != UID_ITEM_FREE) {
+            m_nodeItems[item.item.uid].push_back(item.index);
+        }
+    }
+
+    for (auto &node : m_nodeItems) {
+        std::sort(node.second.begin(), node.second.end(), [this](int32_t index1, int32_t index2) {
+            return m_mft[index1].item.order < m_mft[index2].item.order;
+        });
+    }
+}
+
+// done
+void DirectoryTreeChecker::VisitNode(int32_t index)
+{
+    const mft_item &item = m_mft[index].item;
+
+    if (m_visits[index]++ > 0 || !item.is_directory) {
+        // only the first visit of a directory goes deeper
+        return;
+    }
+
+    auto uids = ReadDirectory(item.uid);
+
+    // skip parent
+    for (size_t i = 1; i < uids.size(); i++) {
+        QueueNode(uids[i], item.uid);
+    }
+}
+
+// done
+void DirectoryTreeChecker::QueueNode(int32_t uid, int32_t parent)
+{
+    auto found = m_nodeItems.find(uid);
+
+    if (found == m_nodeItems.end() || m_mft[found->second.front()].item.order != 0) {
+        std::stringstream ss;
+        ss
+            << "WARNING: the directory " << parent
+            << " contains the node " << uid
+            << " which doesn't exist"
+            << std::endl;
+
+        PrintWarning(ss.str());
+        m_success = false;
+        return;
+    }
+
+    m_pending++;
+
+    int32_t index = found->second.front();
+
+    m_ntfs.m_threadPool.Submit([this, index]() {
+        try {
+            VisitNode(index);
+        }
+        catch (std::exception &exception) {
+            // any failure on a corrupt node must still end the task, or the wait never returns
+            PrintWarning(std::string{"WARNING: "} + exception.what() + "\n");
+            m_success = false;
+        }
+        catch (...) {
+            PrintWarning("WARNING: the directory can't be read\n");
+            m_success = false;
+        }
+
+        m_pending--;
+    });
+}
+
+// done
+std::vector<int32_t> DirectoryTreeChecker::ReadDirectory(int32_t uid)
+{
+    const mft_item &first = m_mft[m_nodeItems.at(uid).front()].item;
+    size_t clusterSize = static_cast<size_t>(m_ntfs.m_partition.GetClusterSize());
+    size_t clusterCount = 0;
+
+    for (auto &index : m_nodeItems.at(uid)) {
+        const mft_item &item = m_mft[index].item;
+
+        for (int i = 0; i < MFT_FRAGMENTS_COUNT && item.fragments[i].start != FRAGMENT_UNUSED_START; i++) {
+            clusterCount += static_cast<size_t>(std::max(item.fragments[i].count, 0));
+        }
+    }
+
+    // the size of a corrupt node may be negative or past its clusters
+    std::vector<int32_t> uids;
+    uids.resize(std::min(static_cast<size_t>(std::max(first.size, 0)), clusterCount * clusterSize) / sizeof(int32_t));
+
+    auto destination = reinterpret_cast<char *>(uids.data());
+    auto remaining = uids.size() * sizeof(int32_t);
+
+    for (auto &index : m_nodeItems.at(uid)) {
+        const mft_item &item = m_mft[index].item;
+
+        for (int i = 0; i < MFT_FRAGMENTS_COUNT && item.fragments[i].start != FRAGMENT_UNUSED_START && remaining > 0; i++) {
+            size_t toRead = std::min(remaining, static_cast<size_t>(item.fragments[i].count) * clusterSize);
+
+            m_ntfs.m_partition.ReadClusterRunShared(item.fragments[i].start, destination, toRead);
+
+            destination += toRead;
+            remaining -= toRead;
+        }
+    }
+
+    return uids;
+}
+
+// done
+void DirectoryTreeChecker::PrintWarning(const std::string &message)
+{
+    std::unique_lock<std::mutex> lock{m_mutexOutput};
+
+    m_output << message;
+}
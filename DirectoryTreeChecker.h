@@ -1,14 +1,15 @@
 #pragma once
 
 #include <mutex>
-#include <set>
 #include <atomic>
+#include <vector>
 #include <memory>
+#include <unordered_map>
 
 #include "Ntfs.h"
 
 /**
- * The class DirectoryTreeChecker contains a logic for the ntfs nodes sizes check.
+ * The class DirectoryTreeChecker contains a logic for the ntfs directory tree check.
  */
 class DirectoryTreeChecker
 {
@@ -23,9 +24,10 @@ public:
 
     /**
      * Run the directory tree checking.
-     * Goes through the directory tree and remembers
-     * visited nodes. Than scans every node on the partition,
+     * Reads the mft once, goes through the directory tree in parallel
+     * and counts the visits of every node. Than scans every node on the partition,
      * and check if it is present in exactly one directory.
+     * Every visit is a task of the thread pool, which queues the visits of the directory children.
      *
      * @return True if everything is OK, false otherwise.
      */
@@ -41,4 +43,71 @@ private:
      * The output to print messages.
      */
     std::ostream &m_output;
+
+    /**
+     * The snapshot of the whole mft.
+     */
+    std::vector<MftItem> m_mft;
+
+    /**
+     * The mft indexes of the node items sorted by their order, by the node uids.
+     */
+    std::unordered_map<int32_t, std::vector<int32_t>> m_nodeItems;
+
+    /**
+     * The number of visits of the nodes by the mft indexes of their first items.
+     */
+    std::unique_ptr<std::atomic<int32_t>[]> m_visits;
+
+    /**
+     * The number of nodes queued but not visited yet.
+     */
+    std::atomic<int32_t> m_pending;
+
+    /**
+     * Indicates whether the walk succeeded.
+     */
+    std::atomic<bool> m_success;
+
+    /**
+     * The mutex to block multiple threads
+     * to access the output concurrently.
+     */
+    std::mutex m_mutexOutput;
+
+    /**
+     * Read the mft and index the node items by the node uids.
+     */
+    void LoadMft();
+
+    /**
+     * Visit the node and queue its children if it is a directory visited for the first time.
+     *
+     * @param index The mft index of the first node item.
+     */
+    void VisitNode(int32_t index);
+
+    /**
+     * Submit the visit of the node to the thread pool.
+     *
+     * @param uid The uid of the node.
+     * @param parent The uid of the directory containing the node.
+     */
+    void QueueNode(int32_t uid, int32_t parent);
+
+    /**
+     * Read the uids of the directory child nodes.
+     *
+     * @param uid The uid of the directory.
+     *
+     * @return The uids, the first one is the uid of the parent directory.
+     */
+    std::vector<int32_t> ReadDirectory(int32_t uid);
+
+    /**
+     * Print the warning into the output.
+     *
+     * @param message The message.
+     */
+    void PrintWarning(const std::string &message);
 };
@@ -0,0 +1,167 @@
+#include "DirtyMap.h"
+
+// done
+DirtyMap::DirtyMap(const std::string &partitionPath)
+    : m_path(partitionPath + ".dirty")
+{}
+
+// done
+void DirtyMap::Load()
+{
+    m_file.close();
+    Reset();
+
+    std::ifstream input{m_path, std::ios::binary};
+
+    if (!input.is_open()) {
+        // the changes since the last check are unknown
+        m_complete = false;
+        return;
+    }
+
+    m_complete = true;
+
+    int32_t record[2];
+
+    while (input.read(reinterpret_cast<char *>(record), sizeof(record))) {
+        switch (record[0]) {
+            case RECORD_MFT_ITEM:
+                m_mftItems.insert(record[1]);
+                break;
+            case RECORD_DIRECTORY:
+                m_directories.insert(record[1]);
+                break;
+            case RECORD_RELINKED:
+                m_relinked.insert(record[1]);
+                break;
+            case RECORD_RELEASED:
+                m_released.insert(record[1]);
+                break;
+            default:
+                m_complete = false;
+                break;
+        }
+    }
+
+    if (input.gcount() != 0) {
+        // torn record at the end
+        m_complete = false;
+    }
+
+    if (m_complete) {
+        m_file.open(m_path, std::ios::binary | std::ios::app);
+    }
+}
+
+// done
+void DirtyMap::MarkMftItem(int32_t index)
+{
+    Mark(m_mftItems, RECORD_MFT_ITEM, index);
+}
+
+// done
+void DirtyMap::MarkDirectory(int32_t uid)
+{
+    Mark(m_directories, RECORD_DIRECTORY, uid);
+}
+
+// done
+void DirtyMap::MarkRelinked(int32_t uid)
+{
+    Mark(m_relinked, RECORD_RELINKED, uid);
+}
+
+// done
+void DirtyMap::MarkReleased(int32_t uid)
+{
+    Mark(m_released, RECORD_RELEASED, uid);
+}
+
+// done
+void DirtyMap::Invalidate()
+{
+    if (!m_complete) {
+        return;
+    }
+
+    Append(RECORD_INVALID, 0);
+
+    m_complete = false;
+    m_file.close();
+    Reset();
+}
+
+// done
+void DirtyMap::Clear()
+{
+    Reset();
+
+    m_file.close();
+    m_file.open(m_path, std::ios::binary | std::ios::trunc);
+    m_file.flush();
+
+    m_complete = m_file.is_open();
+}
+
+// done
+bool DirtyMap::IsComplete() const
+{
+    return m_complete;
+}
+
+// done
+const std::unordered_set<int32_t> &DirtyMap::GetMftItems() const
+{
+    return m_mftItems;
+}
+
+// done
+const std::unordered_set<int32_t> &DirtyMap::GetDirectories() const
+{
+    return m_directories;
+}
+
+// done
+const std::unordered_set<int32_t> &DirtyMap::GetRelinked() const
+{
+    return m_relinked;
+}
+
+// done
+const std::unordered_set<int32_t> &DirtyMap::GetReleased() const
+{
+    return m_released;
+}
+
+// done
+void DirtyMap::Mark(std::unordered_set<int32_t> &set, RecordKind kind, int32_t value)
+{
+    if (!m_complete || !set.insert(value).second) {
+        return;
+    }
+
+    Append(kind, value);
+}
+
+// done
+void DirtyMap::Append(RecordKind kind, int32_t value)
+{
+    int32_t record[2]{kind, value};
+
+    m_file.write(reinterpret_cast<const char *>(record), sizeof(record));
+    m_file.flush();
+
+    if (!m_file) {
+        // the log can't be trusted anymore
+        m_complete = false;
+    }
+}
+
+// done
+void DirtyMap::Reset()
+{
+    m_mftItems.clear();
+    m_directories.clear();
+    m_relinked.clear();
+    m_released.clear();
+}
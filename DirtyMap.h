@@ -0,0 +1,177 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <unordered_set>
+#include <cstdint>
+
+/**
+ * Class DirtyMap keeps the mft items and the directories touched since the last successful check
+ * together with the nodes which were linked into or unlinked from a directory and the released nodes.
+ * The map is persisted in the sidecar file next to the partition file as an append only log
+ * of the records, each mft item or directory is logged only once.
+ * The missing sidecar file or the invalidation record means that the changes are unknown
+ * and the full check is needed.
+ */
+class DirtyMap
+{
+public:
+    /**
+     * Initialize a new DirtyMap bound to the sidecar of the given partition file.
+     * The map is incomplete until it is loaded or cleared.
+     *
+     * @param partitionPath The path of the partition file.
+     */
+    explicit DirtyMap(const std::string &partitionPath);
+
+    /**
+     * Load the map from the sidecar file.
+     * If the file doesn't exist or contains the invalidation record, the map is incomplete.
+     */
+    void Load();
+
+    /**
+     * Mark the mft item as touched.
+     *
+     * @param index The index of the mft item.
+     */
+    void MarkMftItem(int32_t index);
+
+    /**
+     * Mark the directory as touched, its contents or one of its files have changed.
+     *
+     * @param uid The uid of the directory.
+     */
+    void MarkDirectory(int32_t uid);
+
+    /**
+     * Mark the node as relinked - it was created, added into a directory or removed from it.
+     *
+     * @param uid The uid of the node.
+     */
+    void MarkRelinked(int32_t uid);
+
+    /**
+     * Mark the node as released.
+     *
+     * @param uid The uid of the released node.
+     */
+    void MarkReleased(int32_t uid);
+
+    /**
+     * Invalidate the map, the changes can't be tracked and the next check must be the full one.
+     */
+    void Invalidate();
+
+    /**
+     * Clear the map after the successful check.
+     */
+    void Clear();
+
+    /**
+     * Check whether the map holds all the changes since the last successful check.
+     *
+     * @return True if the map is complete, false otherwise.
+     */
+    bool IsComplete() const;
+
+    /**
+     * Get the indexes of the touched mft items.
+     *
+     * @return The set of mft item indexes.
+     */
+    const std::unordered_set<int32_t> &GetMftItems() const;
+
+    /**
+     * Get the uids of the touched directories.
+     *
+     * @return The set of directory uids.
+     */
+    const std::unordered_set<int32_t> &GetDirectories() const;
+
+    /**
+     * Get the uids of the relinked nodes.
+     *
+     * @return The set of node uids.
+     */
+    const std::unordered_set<int32_t> &GetRelinked() const;
+
+    /**
+     * Get the uids of the released nodes.
+     *
+     * @return The set of node uids.
+     */
+    const std::unordered_set<int32_t> &GetReleased() const;
+
+private:
+    /**
+     * The kinds of the sidecar file records.
+     */
+    enum RecordKind : int32_t
+    {
+        RECORD_MFT_ITEM = 0,
+        RECORD_DIRECTORY = 1,
+        RECORD_RELINKED = 2,
+        RECORD_RELEASED = 3,
+        RECORD_INVALID = 4
+    };
+
+    /**
+     * The path of the sidecar file.
+     */
+    std::string m_path;
+
+    /**
+     * The sidecar file stream opened for appending.
+     */
+    std::ofstream m_file;
+
+    /**
+     * Whether the map holds all the changes.
+     */
+    bool m_complete{false};
+
+    /**
+     * The indexes of the touched mft items.
+     */
+    std::unordered_set<int32_t> m_mftItems;
+
+    /**
+     * The uids of the touched directories.
+     */
+    std::unordered_set<int32_t> m_directories;
+
+    /**
+     * The uids of the relinked nodes.
+     */
+    std::unordered_set<int32_t> m_relinked;
+
+    /**
+     * The uids of the released nodes.
+     */
+    std::unordered_set<int32_t> m_released;
+
+    /**
+     * Forget all the marked values.
+     */
+    void Reset();
+
+    /**
+     * Add the value into the set and log it into the sidecar file if it is not there yet.
+     * Nothing is logged while the map is incomplete.
+     *
+     * @param set The set of values.
+     * @param kind The record kind.
+     * @param value The value.
+     */
+    void Mark(std::unordered_set<int32_t> &set, RecordKind kind, int32_t value);
+
+    /**
+     * Append the record to the sidecar file and flush it,
+     * so it is logged before the change itself is written.
+     *
+     * @param kind The record kind.
+     * @param value The record value.
+     */
+    void Append(RecordKind kind, int32_t value);
+};
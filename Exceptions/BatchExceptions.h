@@ -0,0 +1,23 @@
+#pragma once
+
+#include "AppException.h"
+
+class BatchException : public AppException
+{
+    using AppException::AppException;
+};
+
+class BatchRequestException : public BatchException
+{
+    using BatchException::BatchException;
+};
+
+class BatchOutputException : public BatchException
+{
+    using BatchException::BatchException;
+};
+
+class JsonSyntaxException : public BatchRequestException
+{
+    using BatchRequestException::BatchRequestException;
+};
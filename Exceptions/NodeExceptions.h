@@ -7,4 +7,9 @@ class NodeException : public AppException
     using AppException::AppException;
 };
 
+class NodeNotFoundException : public NodeException
+{
+    using NodeException::NodeException;
+};
+
 
@@ -17,6 +17,11 @@ class NodeManagerNotEnoughFreeMftItemsException : public NodeManagerException
     using NodeManagerException::NodeManagerException;
 };
 
+class NodeManagerTooManyFragmentsException : public NodeManagerException
+{
+    using NodeManagerException::NodeManagerException;
+};
+
 class NodeManagerNodeNotFoundException : public NodeManagerException
 {
     using NodeManagerException::NodeManagerException;
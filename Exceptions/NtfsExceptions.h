@@ -51,3 +51,14 @@ class NtfsDirectoryNotEmptyException : public NtfsException
 {
     using NtfsException::NtfsException;
 };
+
+
+class NtfsBadDescriptorException : public NtfsException
+{
+    using NtfsException::NtfsException;
+};
+
+class NtfsDataTooShortException : public NtfsException
+{
+    using NtfsException::NtfsException;
+};
\ No newline at end of file
@@ -48,3 +48,13 @@ class PartitionDataOutOfBoundsException : public PartitionException
 {
     using PartitionException::PartitionException;
 };
+
+class PartitionTransferException : public PartitionException
+{
+    using PartitionException::PartitionException;
+};
+
+class PartitionReadException : public PartitionException
+{
+    using PartitionException::PartitionException;
+};
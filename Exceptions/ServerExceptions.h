@@ -0,0 +1,13 @@
+#pragma once
+
+#include "AppException.h"
+
+class ServerException : public AppException
+{
+    using AppException::AppException;
+};
+
+class ServerSocketException : public ServerException
+{
+    using ServerException::ServerException;
+};
@@ -0,0 +1,46 @@
+#include <algorithm>
+
+#include "ExtentMap.h"
+
+// done
+ExtentMap::ExtentMap(const Node &node)
+    : m_extents(node.GetFragments())
+{
+    m_offsets.reserve(m_extents.size());
+
+    for (auto &extent : m_extents) {
+        m_offsets.push_back(m_clusterCount);
+        m_clusterCount += extent.count;
+    }
+}
+
+// done
+size_t ExtentMap::FindExtent(int32_t clusterOffset) const
+{
+    if (clusterOffset < 0 || clusterOffset >= m_clusterCount) {
+        return m_extents.size();
+    }
+
+    // find the last extent starting on the position or before it
+    auto found = std::upper_bound(m_offsets.begin(), m_offsets.end(), clusterOffset);
+
+    return static_cast<size_t>(found - m_offsets.begin() - 1);
+}
+
+// done
+const std::vector<mft_fragment> &ExtentMap::GetExtents() const
+{
+    return m_extents;
+}
+
+// done
+int32_t ExtentMap::GetExtentOffset(size_t index) const
+{
+    return m_offsets[index];
+}
+
+// done
+int32_t ExtentMap::GetClusterCount() const
+{
+    return m_clusterCount;
+}
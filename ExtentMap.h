@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "NtfsStructs.h"
+#include "Node.h"
+
+/**
+ * Class ExtentMap maps the clusters positions within a node
+ * to the node extents (fragments) and their clusters on the partition.
+ * It keeps the cumulative cluster offsets of the extents,
+ * so the extent holding a given position is found by the binary search.
+ */
+class ExtentMap
+{
+public:
+    /**
+     * Defaulted empty ExtentMap constructor.
+     */
+    ExtentMap() = default;
+
+    /**
+     * Initialize a new ExtentMap of the given node.
+     *
+     * @param node The node which extents will be mapped.
+     */
+    explicit ExtentMap(const Node &node);
+
+    /**
+     * Find the extent holding the cluster on the given position within the node.
+     *
+     * @param clusterOffset The position of the cluster within the node.
+     *
+     * @return The index of the extent or the extent count if the position is out of the node clusters.
+     */
+    size_t FindExtent(int32_t clusterOffset) const;
+
+    /**
+     * Get the node extents.
+     *
+     * @return The vector of extents.
+     */
+    const std::vector<mft_fragment> &GetExtents() const;
+
+    /**
+     * Get the position of the first cluster of the extent within the node.
+     *
+     * @param index The index of the extent.
+     *
+     * @return The cluster position.
+     */
+    int32_t GetExtentOffset(size_t index) const;
+
+    /**
+     * Get the total number of the node clusters.
+     *
+     * @return The cluster count.
+     */
+    int32_t GetClusterCount() const;
+
+private:
+    /**
+     * The node extents in their order within the node.
+     */
+    std::vector<mft_fragment> m_extents;
+
+    /**
+     * The positions of the first clusters of the extents within the node.
+     */
+    std::vector<int32_t> m_offsets;
+
+    /**
+     * The total number of the node clusters.
+     */
+    int32_t m_clusterCount{0};
+};
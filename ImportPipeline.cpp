@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#include "ImportPipeline.h"
+#include "Exceptions/PartitionExceptions.h"
+
+// done
+ImportPipeline::ImportPipeline(ThreadPool &threadPool, int source, size_t dataSize, size_t bufferSize, size_t bufferCount)
+    : m_threadPool(threadPool),
+      m_source{source},
+      m_dataSize{dataSize},
+      m_cancelled{false}
+{
+    bufferSize = std::min(bufferSize, std::max(dataSize, size_t{1}));
+
+    for (size_t i = 0; i < bufferCount; i++) {
+        m_buffers.emplace_back(bufferSize);
+        m_freeBuffers.push(i);
+    }
+}
+
+// done
+void ImportPipeline::Run(const Consumer &consumer)
+{
+    auto reader = m_threadPool.Submit([this]() {
+        RunReader();
+    });
+
+    try {
+        for (size_t consumed = 0; consumed < m_dataSize;) {
+            std::pair<size_t, size_t> filled;
+
+            {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_changed.wait(lock, [this] { return !m_filledBuffers.empty() || !m_error.empty(); });
+
+                if (m_filledBuffers.empty()) {
+                    throw PartitionTransferException{m_error};
+                }
+
+                filled = m_filledBuffers.front();
+                m_filledBuffers.pop();
+            }
+
+            consumer(m_buffers[filled.first].data(), filled.second);
+            consumed += filled.second;
+
+            {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_freeBuffers.push(filled.first);
+            }
+
+            m_changed.notify_all();
+        }
+    }
+    catch (...) {
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_cancelled = true;
+        }
+
+        m_changed.notify_all();
+        m_threadPool.WaitUntil([&reader]() {
+            return reader.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+        });
+        throw;
+    }
+
+    m_threadPool.WaitUntil([&reader]() {
+        return reader.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+    });
+}
+
+// done
+void ImportPipeline::RunReader()
+{
+    for (size_t read = 0; read < m_dataSize;) {
+        size_t index;
+
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_changed.wait(lock, [this] { return !m_freeBuffers.empty() || m_cancelled; });
+
+            if (m_cancelled) {
+                return;
+            }
+
+            index = m_freeBuffers.front();
+            m_freeBuffers.pop();
+        }
+
+        size_t toRead = std::min(m_dataSize - read, m_buffers[index].size());
+        std::string error = Fill(m_buffers[index], toRead);
+        bool failed = !error.empty();
+
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+
+            if (failed) {
+                m_error = std::move(error);
+            } else {
+                m_filledBuffers.emplace(index, toRead);
+            }
+        }
+
+        m_changed.notify_all();
+
+        if (failed) {
+            return;
+        }
+
+        read += toRead;
+    }
+}
+
+// done
+std::string ImportPipeline::Fill(std::vector<char> &buffer, size_t size)
+{
+    for (size_t filled = 0; filled < size;) {
+        ssize_t count = read(m_source, buffer.data() + filled, size - filled);
+
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return "can't read the data: " + std::string{std::strerror(errno)};
+        }
+
+        if (count == 0) {
+            return "the source data ended unexpectedly";
+        }
+
+        filled += count;
+    }
+
+    return "";
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <queue>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "ThreadPool.h"
+
+/**
+ * Class ImportPipeline reads the data from a file descriptor in a reader task run by the thread pool
+ * and hands them over to the consumer running in the calling thread.
+ * The threads are connected by a ring of buffers, so the reading of the next
+ * buffer overlaps with the consuming of the previous one.
+ */
+class ImportPipeline
+{
+public:
+    /**
+     * The function consuming one filled buffer.
+     */
+    typedef std::function<void(const char *data, size_t size)> Consumer;
+
+    /**
+     * Initialize a new ImportPipeline.
+     *
+     * @param threadPool The thread pool running the reader.
+     * @param source The source file descriptor, read from its current offset.
+     * @param dataSize The number of bytes to be read.
+     * @param bufferSize The size of one buffer in bytes.
+     * @param bufferCount The number of buffers in the ring.
+     */
+    ImportPipeline(ThreadPool &threadPool, int source, size_t dataSize, size_t bufferSize, size_t bufferCount);
+
+    /**
+     * Read all the data and pass them to the consumer buffer by buffer in their order.
+     * If the consumer throws, the reading is stopped and the exception is rethrown.
+     *
+     * @param consumer The function consuming the buffers.
+     *
+     * @throws PartitionTransferException When the reading fails or the source ends too early.
+     */
+    void Run(const Consumer &consumer);
+
+private:
+    /**
+     * The thread pool running the reader.
+     */
+    ThreadPool &m_threadPool;
+
+    /**
+     * The source file descriptor.
+     */
+    int m_source;
+
+    /**
+     * The number of bytes to be read.
+     */
+    size_t m_dataSize;
+
+    /**
+     * The ring of buffers.
+     */
+    std::vector<std::vector<char>> m_buffers;
+
+    /**
+     * The indexes of the buffers ready to be filled.
+     */
+    std::queue<size_t> m_freeBuffers;
+
+    /**
+     * The indexes and data sizes of the buffers ready to be consumed.
+     */
+    std::queue<std::pair<size_t, size_t>> m_filledBuffers;
+
+    /**
+     * Whether the consumer stopped the pipeline.
+     */
+    bool m_cancelled;
+
+    /**
+     * The message of the reading error, empty if there is none.
+     */
+    std::string m_error;
+
+    /**
+     * Mutex for the buffer queues and the state.
+     */
+    std::mutex m_mutex;
+
+    /**
+     * Condition variable signalling the queues changes.
+     */
+    std::condition_variable m_changed;
+
+    /**
+     * Read the data into the free buffers until all are read or the pipeline is cancelled.
+     */
+    void RunReader();
+
+    /**
+     * Fill the buffer from the source.
+     *
+     * @param buffer The buffer.
+     * @param size The number of bytes to be read.
+     *
+     * @return The error message or an empty string on success.
+     */
+    std::string Fill(std::vector<char> &buffer, size_t size);
+};
@@ -0,0 +1,314 @@
+#include <cstdlib>
+
+#include "JsonReader.h"
+#include "NtfsStructs.h"
+
+// done
+JsonReader::JsonReader(const std::string &text)
+    : m_text(text)
+{}
+
+// done
+bool JsonReader::Consume(char character)
+{
+    if (Peek() != character || m_position >= m_text.size()) {
+        return false;
+    }
+
+    m_position++;
+    return true;
+}
+
+// done
+void JsonReader::Expect(char character)
+{
+    if (!Consume(character)) {
+        throw Error(std::string{"expected '"} + character + "'");
+    }
+}
+
+// done
+void JsonReader::ExpectEnd()
+{
+    SkipWhitespace();
+
+    if (m_position < m_text.size()) {
+        throw Error("unexpected text after the value");
+    }
+}
+
+// done
+std::string JsonReader::ReadString()
+{
+    Expect('"');
+
+    std::string string;
+
+    while (true) {
+        if (m_position >= m_text.size()) {
+            throw Error("unterminated string");
+        }
+
+        char c = m_text[m_position++];
+
+        if (c == '"') {
+            return string;
+        }
+
+        if (static_cast<unsigned char>(c) < 0x20) {
+            throw Error("control character in string");
+        }
+
+        if (c != '\\') {
+            string += c;
+            continue;
+        }
+
+        if (m_position >= m_text.size()) {
+            throw Error("unterminated string");
+        }
+
+        c = m_text[m_position++];
+
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                string += c;
+                break;
+            case 'b':
+                string += '\b';
+                break;
+            case 'f':
+                string += '\f';
+                break;
+            case 'n':
+                string += '\n';
+                break;
+            case 'r':
+                string += '\r';
+                break;
+            case 't':
+                string += '\t';
+                break;
+            case 'u': {
+                uint32_t code = ReadCodeUnit();
+
+                if (code >= 0xd800 && code < 0xdc00) {
+                    // the high surrogate must be followed by the low one
+                    if (m_text.compare(m_position, 2, "\\u") != 0) {
+                        throw Error("unpaired surrogate");
+                    }
+
+                    m_position += 2;
+                    uint32_t low = ReadCodeUnit();
+
+                    if (low < 0xdc00 || low >= 0xe000) {
+                        throw Error("unpaired surrogate");
+                    }
+
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+                else if (code >= 0xdc00 && code < 0xe000) {
+                    throw Error("unpaired surrogate");
+                }
+
+                // encode the code point into utf-8
+                if (code < 0x80) {
+                    string += static_cast<char>(code);
+                }
+                else if (code < 0x800) {
+                    string += static_cast<char>(0xc0 | (code >> 6));
+                    string += static_cast<char>(0x80 | (code & 0x3f));
+                }
+                else if (code < 0x10000) {
+                    string += static_cast<char>(0xe0 | (code >> 12));
+                    string += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                    string += static_cast<char>(0x80 | (code & 0x3f));
+                }
+                else {
+                    string += static_cast<char>(0xf0 | (code >> 18));
+                    string += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+                    string += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                    string += static_cast<char>(0x80 | (code & 0x3f));
+                }
+                break;
+            }
+            default:
+                throw Error("invalid escape in string");
+        }
+    }
+}
+
+// done
+std::string JsonReader::ReadRaw()
+{
+    SkipWhitespace();
+    size_t start = m_position;
+
+    SkipValue();
+
+    return m_text.substr(start, m_position - start);
+}
+
+// done
+void JsonReader::SkipValue()
+{
+    char next = Peek();
+
+    if (next == '"') {
+        ReadString();
+        return;
+    }
+
+    if (next != '{' && next != '[') {
+        SkipLiteral();
+        return;
+    }
+
+    if (m_depth >= JSON_MAX_DEPTH) {
+        throw Error("the value is nested too deep");
+    }
+
+    m_depth++;
+    m_position++;
+
+    if (next == '{') {
+        if (!Consume('}')) {
+            do {
+                ReadString();
+                Expect(':');
+                SkipValue();
+            } while (Consume(','));
+
+            Expect('}');
+        }
+    }
+    else {
+        if (!Consume(']')) {
+            do {
+                SkipValue();
+            } while (Consume(','));
+
+            Expect(']');
+        }
+    }
+
+    m_depth--;
+}
+
+// done
+char JsonReader::Peek()
+{
+    SkipWhitespace();
+
+    return m_position < m_text.size() ? m_text[m_position] : '\0';
+}
+
+// done
+void JsonReader::SkipWhitespace()
+{
+    while (m_position < m_text.size()) {
+        char c = m_text[m_position];
+
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+            break;
+        }
+
+        m_position++;
+    }
+}
+
+// done
+void JsonReader::SkipLiteral()
+{
+    SkipWhitespace();
+
+    for (const char *word : {"true", "false", "null"}) {
+        if (m_text.compare(m_position, std::char_traits<char>::length(word), word) == 0) {
+            m_position += std::char_traits<char>::length(word);
+            return;
+        }
+    }
+
+    // the number: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    size_t start = m_position;
+
+    auto digits = [this]() {
+        size_t from = m_position;
+
+        while (m_position < m_text.size() && m_text[m_position] >= '0' && m_text[m_position] <= '9') {
+            m_position++;
+        }
+
+        return m_position - from;
+    };
+
+    if (m_position < m_text.size() && m_text[m_position] == '-') {
+        m_position++;
+    }
+
+    size_t integerStart = m_position;
+    size_t integerDigits = digits();
+
+    if (integerDigits == 0 || (integerDigits > 1 && m_text[integerStart] == '0')) {
+        m_position = start;
+        throw Error("invalid value");
+    }
+
+    if (m_position < m_text.size() && m_text[m_position] == '.') {
+        m_position++;
+
+        if (digits() == 0) {
+            throw Error("invalid number");
+        }
+    }
+
+    if (m_position < m_text.size() && (m_text[m_position] == 'e' || m_text[m_position] == 'E')) {
+        m_position++;
+
+        if (m_position < m_text.size() && (m_text[m_position] == '+' || m_text[m_position] == '-')) {
+            m_position++;
+        }
+
+        if (digits() == 0) {
+            throw Error("invalid number");
+        }
+    }
+}
+
+// done
+uint32_t JsonReader::ReadCodeUnit()
+{
+    if (m_position + 4 > m_text.size()) {
+        throw Error("invalid unicode escape");
+    }
+
+    uint32_t code{0};
+
+    for (int i = 0; i < 4; i++) {
+        char c = m_text[m_position++];
+        code <<= 4;
+
+        if (c >= '0' && c <= '9') {
+            code |= static_cast<uint32_t>(c - '0');
+        }
+        else if (c >= 'a' && c <= 'f') {
+            code |= static_cast<uint32_t>(c - 'a' + 10);
+        }
+        else if (c >= 'A' && c <= 'F') {
+            code |= static_cast<uint32_t>(c - 'A' + 10);
+        }
+        else {
+            throw Error("invalid unicode escape");
+        }
+    }
+
+    return code;
+}
+
+// done
+JsonSyntaxException JsonReader::Error(const std::string &message) const
+{
+    return JsonSyntaxException{message + " at position " + std::to_string(m_position)};
+}
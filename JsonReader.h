@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Exceptions/BatchExceptions.h"
+
+/**
+ * Class JsonReader reads the json values from a text one by one.
+ * It is a minimal reader for the batch requests, the strings are decoded into utf-8
+ * and the other values are either skipped or taken as their raw json text.
+ */
+class JsonReader
+{
+public:
+    /**
+     * Initializes a new JsonReader at the start of the text.
+     *
+     * @param text The json text, it must outlive the reader.
+     */
+    explicit JsonReader(const std::string &text);
+
+    /**
+     * Skip the whitespace and the given character if it is next.
+     *
+     * @param character The expected character.
+     *
+     * @return True if the character was skipped, false otherwise.
+     */
+    bool Consume(char character);
+
+    /**
+     * Skip the whitespace and the given character.
+     *
+     * @param character The expected character.
+     *
+     * @throws JsonSyntaxException When the character isn't next.
+     */
+    void Expect(char character);
+
+    /**
+     * Check that only the whitespace remains in the text.
+     *
+     * @throws JsonSyntaxException When something else remains.
+     */
+    void ExpectEnd();
+
+    /**
+     * Read the string value.
+     *
+     * @throws JsonSyntaxException When the next value isn't a valid string.
+     *
+     * @return The decoded string.
+     */
+    std::string ReadString();
+
+    /**
+     * Read any value and return its json text.
+     *
+     * @throws JsonSyntaxException When the next value isn't valid.
+     *
+     * @return The raw json text of the value.
+     */
+    std::string ReadRaw();
+
+    /**
+     * Skip any value, the nested objects and arrays included.
+     *
+     * @throws JsonSyntaxException When the next value isn't valid or it is nested too deep.
+     */
+    void SkipValue();
+
+    /**
+     * Skip the whitespace and get the next character.
+     *
+     * @return The next character or '\0' at the end of the text.
+     */
+    char Peek();
+
+private:
+    /**
+     * The json text.
+     */
+    const std::string &m_text;
+
+    /**
+     * The position of the next character in the text.
+     */
+    size_t m_position{0};
+
+    /**
+     * The nesting of the values being skipped.
+     */
+    int m_depth{0};
+
+    /**
+     * Skip the whitespace.
+     */
+    void SkipWhitespace();
+
+    /**
+     * Skip the number, true, false or null.
+     *
+     * @throws JsonSyntaxException When the next value isn't a valid literal.
+     */
+    void SkipLiteral();
+
+    /**
+     * Read the four hex digits of the unicode escape.
+     *
+     * @throws JsonSyntaxException When the digits are missing.
+     *
+     * @return The code unit.
+     */
+    uint32_t ReadCodeUnit();
+
+    /**
+     * Build the syntax error at the current position.
+     *
+     * @param message The error description.
+     *
+     * @return The exception to be thrown.
+     */
+    JsonSyntaxException Error(const std::string &message) const;
+};
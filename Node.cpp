@@ -48,44 +48,52 @@ const std::vector<MftItem> &Node::GetMftItems() const
 // done
 std::vector<mft_fragment> Node::GetFragments() const
 {
-    std::vector<mft_fragment> fragments;
+    auto extents = GetExtents();
 
-    for (auto &mftItem : m_mftItems) {
-        const mft_item &item = mftItem.item;
-
-        // loop over fragments and add them to the vector
-        for (int i = 0; i < MFT_FRAGMENTS_COUNT; i++) {
+    return std::vector<mft_fragment>{extents.begin(), extents.end()};
+}
 
-            if (item.fragments[i].start == FRAGMENT_UNUSED_START) {
-                // fragment is unused
-                break;
-            }
+// done
+Node::ExtentRange Node::GetExtents() const
+{
+    return ExtentRange{m_mftItems};
+}
 
-            fragments.emplace_back(item.fragments[i]);
-        }
-    }
+// done
+size_t Node::GetExtentCount() const
+{
+    auto extents = GetExtents();
 
-    return fragments;
+    return static_cast<size_t>(std::distance(extents.begin(), extents.end()));
 }
 
 // done
-std::vector<int32_t> Node::GetClusters() const
+int32_t Node::GetClusterCount() const
 {
-    std::vector<int32_t> clusters;
-    auto fragments = GetFragments();
+    int32_t count{0};
 
-    for (auto &fragment : fragments) {
+    for (auto &extent : GetExtents()) {
+        count += extent.count;
+    }
 
-        if (fragment.start == FRAGMENT_UNUSED_START) {
-            break;
-        }
+    return count;
+}
+
+// done
+int32_t Node::GetLastCluster() const
+{
+    // loop over the fragments backwards and find the last used one
+    for (auto itItem = m_mftItems.rbegin(); itItem != m_mftItems.rend(); itItem++) {
+        const mft_item &item = itItem->item;
 
-        for (int j = 0; j < fragment.count; j++) {
-            clusters.push_back(fragment.start + j);
+        for (int i = MFT_FRAGMENTS_COUNT - 1; i >= 0; i--) {
+            if (item.fragments[i].start != FRAGMENT_UNUSED_START) {
+                return item.fragments[i].start + item.fragments[i].count - 1;
+            }
         }
     }
 
-    return clusters;
+    return FRAGMENT_UNUSED_START;
 }
 
 // done
@@ -96,3 +104,83 @@ Node::Node(std::vector<MftItem> mftItems)
         throw NodeException{"no mft items given for the node creation"};
     }
 }
+
+// done
+Node::ExtentIterator::ExtentIterator(std::vector<MftItem>::const_iterator item,
+                                     std::vector<MftItem>::const_iterator end)
+    : m_item{item},
+      m_end{end},
+      m_fragment{0}
+{
+    SkipUnused();
+}
+
+// done
+Node::ExtentIterator::reference Node::ExtentIterator::operator*() const
+{
+    return m_item->item.fragments[m_fragment];
+}
+
+// done
+Node::ExtentIterator::pointer Node::ExtentIterator::operator->() const
+{
+    return &m_item->item.fragments[m_fragment];
+}
+
+// done
+Node::ExtentIterator &Node::ExtentIterator::operator++()
+{
+    m_fragment++;
+    SkipUnused();
+
+    return *this;
+}
+
+// done
+Node::ExtentIterator Node::ExtentIterator::operator++(int)
+{
+    ExtentIterator previous{*this};
+    ++(*this);
+
+    return previous;
+}
+
+// done
+bool Node::ExtentIterator::operator==(const ExtentIterator &other) const
+{
+    return m_item == other.m_item && m_fragment == other.m_fragment;
+}
+
+// done
+bool Node::ExtentIterator::operator!=(const ExtentIterator &other) const
+{
+    return !(*this == other);
+}
+
+// done
+void Node::ExtentIterator::SkipUnused()
+{
+    // the used fragments are at the beginning of each mft item
+    while (m_item != m_end
+        && (m_fragment == MFT_FRAGMENTS_COUNT || m_item->item.fragments[m_fragment].start == FRAGMENT_UNUSED_START)) {
+        m_item++;
+        m_fragment = 0;
+    }
+}
+
+// done
+Node::ExtentRange::ExtentRange(const std::vector<MftItem> &mftItems)
+    : m_mftItems(mftItems)
+{}
+
+// done
+Node::ExtentIterator Node::ExtentRange::begin() const
+{
+    return ExtentIterator{m_mftItems.begin(), m_mftItems.end()};
+}
+
+// done
+Node::ExtentIterator Node::ExtentRange::end() const
+{
+    return ExtentIterator{m_mftItems.end(), m_mftItems.end()};
+}
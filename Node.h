@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <cstddef>
+#include <iterator>
 
 #include "NtfsStructs.h"
 
@@ -18,6 +20,131 @@ class Node
     friend class NodeManager;
     friend class NtfsChecker;
 public:
+    /**
+     * Class ExtentIterator iterates over the used fragments
+     * of the node mft items in their order without copying them.
+     */
+    class ExtentIterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = mft_fragment;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const mft_fragment *;
+        using reference = const mft_fragment &;
+
+        /**
+         * Initialize a new ExtentIterator pointing to the first used fragment
+         * of the given mft item or behind it.
+         *
+         * @param item The mft item to start from.
+         * @param end The end of the mft items.
+         */
+        ExtentIterator(std::vector<MftItem>::const_iterator item, std::vector<MftItem>::const_iterator end);
+
+        /**
+         * Get the current fragment.
+         *
+         * @return The fragment.
+         */
+        reference operator*() const;
+
+        /**
+         * Access the current fragment.
+         *
+         * @return The pointer to the fragment.
+         */
+        pointer operator->() const;
+
+        /**
+         * Move to the next used fragment.
+         *
+         * @return This iterator.
+         */
+        ExtentIterator &operator++();
+
+        /**
+         * Move to the next used fragment.
+         *
+         * @return The iterator before the move.
+         */
+        ExtentIterator operator++(int);
+
+        /**
+         * Check whether both iterators point to the same fragment.
+         *
+         * @param other The other iterator.
+         *
+         * @return True if they are equal, false otherwise.
+         */
+        bool operator==(const ExtentIterator &other) const;
+
+        /**
+         * Check whether the iterators point to different fragments.
+         *
+         * @param other The other iterator.
+         *
+         * @return True if they are not equal, false otherwise.
+         */
+        bool operator!=(const ExtentIterator &other) const;
+
+    private:
+        /**
+         * The current mft item.
+         */
+        std::vector<MftItem>::const_iterator m_item;
+
+        /**
+         * The end of the mft items.
+         */
+        std::vector<MftItem>::const_iterator m_end;
+
+        /**
+         * The index of the current fragment in the current mft item.
+         */
+        int m_fragment;
+
+        /**
+         * Skip the unused fragments until a used one or the end is reached.
+         */
+        void SkipUnused();
+    };
+
+    /**
+     * Class ExtentRange is a view of the node fragments usable in the range based for.
+     * It is valid only as long as the node it was taken from is not changed.
+     */
+    class ExtentRange
+    {
+    public:
+        /**
+         * Initialize a new ExtentRange over the given mft items.
+         *
+         * @param mftItems The mft items.
+         */
+        explicit ExtentRange(const std::vector<MftItem> &mftItems);
+
+        /**
+         * Get the iterator pointing to the first fragment.
+         *
+         * @return The iterator.
+         */
+        ExtentIterator begin() const;
+
+        /**
+         * Get the iterator pointing behind the last fragment.
+         *
+         * @return The iterator.
+         */
+        ExtentIterator end() const;
+
+    private:
+        /**
+         * The iterated mft items.
+         */
+        const std::vector<MftItem> &m_mftItems;
+    };
+
     /**
      * Defaulted empty Node constructor
      */
@@ -99,11 +226,32 @@ public:
     std::vector<mft_fragment> GetFragments() const;
 
     /**
-     * Get the indexes of the clusters acquired by this node.
+     * Get the fragments acquired by this node without copying them.
+     *
+     * @return The range of fragments.
+     */
+    ExtentRange GetExtents() const;
+
+    /**
+     * Get the number of fragments acquired by this node.
+     *
+     * @return The fragment count.
+     */
+    size_t GetExtentCount() const;
+
+    /**
+     * Get the number of clusters acquired by this node.
+     *
+     * @return The cluster count.
+     */
+    int32_t GetClusterCount() const;
+
+    /**
+     * Get the index of the last cluster acquired by this node.
      *
-     * @return The vector of cluster indexes.
+     * @return The cluster index or FRAGMENT_UNUSED_START if the node has no clusters.
      */
-    std::vector<int32_t> GetClusters() const;
+    int32_t GetLastCluster() const;
 
 private:
     /**
@@ -0,0 +1,21 @@
+#include "NodeInvariants.h"
+
+// done
+bool NodeInvariants::IsFragmentInBounds(const mft_fragment &fragment, int32_t clusterCount)
+{
+    return fragment.start >= 0 && fragment.count > 0 && fragment.start <= clusterCount - fragment.count;
+}
+
+// done
+int NodeInvariants::CompareClustersWithSize(int32_t nodeClusterCount, int32_t size, int32_t clusterSize)
+{
+    if (static_cast<int64_t>(nodeClusterCount) * clusterSize < size) {
+        return -1;
+    }
+
+    if (static_cast<int64_t>(nodeClusterCount - 1) * clusterSize > size) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include "NtfsStructs.h"
+
+/**
+ * Class NodeInvariants holds the rules, which every node on a consistent partition satisfies.
+ * The checkers, the repair and the scrubber test the nodes by them, so they all agree on what is broken.
+ */
+class NodeInvariants
+{
+public:
+    /**
+     * Check whether the fragment lies within the data segment.
+     *
+     * @param fragment The used fragment.
+     * @param clusterCount The number of clusters in the data segment.
+     *
+     * @return True if the fragment is non empty and within the data segment, false otherwise.
+     */
+    static bool IsFragmentInBounds(const mft_fragment &fragment, int32_t clusterCount);
+
+    /**
+     * Compare the number of the node clusters with the number needed for the node size.
+     *
+     * @param nodeClusterCount The number of the node clusters.
+     * @param size The node size in bytes.
+     * @param clusterSize The size of one cluster.
+     *
+     * @return Negative if there are fewer clusters than needed, positive if more, 0 if they correspond.
+     */
+    static int CompareClustersWithSize(int32_t nodeClusterCount, int32_t size, int32_t clusterSize);
+};
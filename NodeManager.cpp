@@ -2,29 +2,37 @@
 
 #include <utility>
 
+#include <algorithm>
+#include <cmath>
 #include <random>
 #include <cstring>
 #include <iostream>
 #include <chrono>
-#include <sstream>
+#include <tuple>
 
 #include "NodeManager.h"
 #include "Exceptions/NodeManagerExceptions.h"
 
 // done
-NodeManager::NodeManager(Partition &partition)
-    : m_partition(partition)
+NodeManager::NodeManager(Partition &partition, ThreadPool &threadPool)
+    : m_partition(partition),
+      m_threadPool(threadPool)
 {}
 
 // done
-Node NodeManager::CreateNode(std::string name, bool isDirectory, int32_t size)
+Node NodeManager::CreateNode(std::string name, bool isDirectory, int32_t size, int32_t goal)
 {
-    auto fragments = FindFreeFragments(size);
+    auto fragments = FindFreeFragments(GetClustersNeeded(size), goal);
+    NormalizeFragments(fragments);
+
     auto mftItems = FindFreeMftItems(fragments.size());
     auto uid = GetFreeUid();
 
     SetupMftItems(mftItems, uid, std::move(name), isDirectory, size, fragments);
 
+    // the new node must be linked into a directory before the next check
+    m_partition.GetDirtyMap().MarkRelinked(uid);
+
     Node node{std::move(mftItems)};
     SaveNode(node);
 
@@ -34,8 +42,8 @@ Node NodeManager::CreateNode(std::string name, bool isDirectory, int32_t size)
 // done
 void NodeManager::SaveNode(const Node &node)
 {
-    for (auto &cluster : node.GetClusters()) {
-        m_partition.WriteBitmapBit(cluster, true);
+    for (auto &extent : node.GetExtents()) {
+        m_partition.WriteBitmapRun(extent.start, extent.count, true);
     }
 
     for (auto &mftItem : node.GetMftItems()) {
@@ -46,8 +54,15 @@ void NodeManager::SaveNode(const Node &node)
 // done
 void NodeManager::ReleaseNode(const Node &node)
 {
-    for (auto &cluster : node.GetClusters()) {
-        m_partition.WriteBitmapBit(cluster, false);
+    if (node.GetMftItems().empty()) {
+        // the node wasn't created, there is nothing to release
+        return;
+    }
+
+    m_partition.GetDirtyMap().MarkReleased(node.GetUid());
+
+    for (auto &extent : node.GetExtents()) {
+        m_partition.WriteBitmapRun(extent.start, extent.count, false);
     }
 
     for (auto &mftItem : node.GetMftItems()) {
@@ -62,32 +77,84 @@ void NodeManager::ReleaseNode(const Node &node)
 // done
 void NodeManager::ResizeNode(Node &node, int32_t size)
 {
-    auto capacity = GetNodeCapacity(node);
+    auto fragments = node.GetFragments();
+    auto clusterCount = node.GetClusterCount();
+    int32_t clustersNeeded = GetClustersNeeded(size);
 
-    if (size <= capacity && size > capacity - m_partition.GetClusterSize()) {
-        // no need for the resources reallocation
+    std::vector<mft_fragment> addedFragments;
+    std::vector<mft_fragment> releasedFragments;
 
-        SetupMftItems(node.m_mftItems, node.GetUid(), node.GetName(), node.IsDirectory(), size, node.GetFragments());
-        SaveNode(node);
+    if (clustersNeeded > clusterCount) {
+        // grow the node - try to continue right behind its last cluster
+        addedFragments = FindFreeFragments(clustersNeeded - clusterCount, node.GetLastCluster() + 1);
+        fragments.insert(fragments.end(), addedFragments.begin(), addedFragments.end());
+    }
 
-        return;
+    // shrink the node - release the clusters behind its new end
+    for (int32_t toRelease = clusterCount - clustersNeeded; toRelease > 0;) {
+        mft_fragment &last = fragments.back();
+        int32_t released = std::min(toRelease, last.count);
+
+        releasedFragments.push_back(mft_fragment{last.start + last.count - released, released});
+
+        last.count -= released;
+        toRelease -= released;
+
+        if (last.count == 0) {
+            fragments.pop_back();
+        }
+    }
+
+    NormalizeFragments(fragments);
+
+    if (fragments.size() > GetMaxFragmentCount()) {
+        // too fragmented - relocate the whole node into the largest free runs
+        addedFragments = FindLargestFreeFragments(clustersNeeded);
+        CopyFragments(node.GetFragments(), addedFragments, std::min(clusterCount, clustersNeeded));
+
+        releasedFragments = node.GetFragments();
+        fragments = addedFragments;
     }
 
-    ReleaseNode(node);
+    // acquire or release the mft items
+    std::vector<MftItem> mftItems{node.m_mftItems};
+    std::vector<MftItem> releasedItems;
+
+    auto itemsNeeded = static_cast<size_t>(
+        std::ceil(static_cast<double>(fragments.size()) / m_partition.GetMftMaxFragmentsCount()));
+    itemsNeeded = std::max(itemsNeeded, size_t{1});
+
+    if (itemsNeeded > mftItems.size()) {
+        auto freeItems = FindFreeMftItems((itemsNeeded - mftItems.size()) * m_partition.GetMftMaxFragmentsCount());
+        mftItems.insert(mftItems.end(), freeItems.begin(), freeItems.end());
+    }
+
+    while (mftItems.size() > itemsNeeded) {
+        MftItem item = mftItems.back();
+        item.item = mft_item{};
+        item.item.uid = UID_ITEM_FREE;
 
-    try {
-        auto fragments = FindFreeFragments(size);
-        auto mftItems = FindFreeMftItems(fragments.size());
+        releasedItems.emplace_back(item);
+        mftItems.pop_back();
+    }
 
-        SetupMftItems(mftItems, node.GetUid(), node.GetName(), node.IsDirectory(), size, fragments);
-        node.m_mftItems = std::move(mftItems);
+    SetupMftItems(mftItems, node.GetUid(), node.GetName(), node.IsDirectory(), size, fragments);
 
-        SaveNode(node);
+    // write the changes
+    for (auto &fragment : addedFragments) {
+        m_partition.WriteBitmapRun(fragment.start, fragment.count, true);
     }
-    catch (NodeManagerException &exception) {
-        SaveNode(node);
-        throw;
+
+    std::vector<MftItem> changedItems{mftItems};
+    changedItems.insert(changedItems.end(), releasedItems.begin(), releasedItems.end());
+
+    m_partition.WriteMftItems(changedItems);
+
+    for (auto &fragment : releasedFragments) {
+        m_partition.WriteBitmapRun(fragment.start, fragment.count, false);
     }
+
+    node.m_mftItems = std::move(mftItems);
 }
 
 // done
@@ -98,21 +165,108 @@ void NodeManager::RenameNode(Node &node, std::string name)
 }
 
 // done
-Node NodeManager::CloneNode(const Node &node, std::string name)
+Node NodeManager::CloneNode(const Node &node, std::string name, int32_t goal)
 {
-    Node clone = CreateNode(name, node.IsDirectory(), node.GetSize());
-    std::stringstream contents;
+    Node clone = CreateNode(name, node.IsDirectory(), node.GetSize(), goal);
 
-    ReadFromNode(node, contents);
-    WriteIntoNode(clone, contents);
+    CopyFragments(node.GetFragments(), clone.GetFragments(), clone.GetClusterCount());
 
     return clone;
 }
 
 // done
-Node NodeManager::FindNode(int32_t uid)
+bool NodeManager::RelocateNode(Node &node, int32_t goal)
+{
+    if (goal < 0) {
+        goal = node.GetMftItems().front().item.fragments[0].start;
+    }
+
+    auto clusterCount = node.GetClusterCount();
+    auto run = FindFreeRun(m_partition.ReadBitmap(), clusterCount, goal);
+
+    if (run.start == FRAGMENT_UNUSED_START) {
+        return false;
+    }
+
+    MoveNode(node, run);
+
+    return true;
+}
+
+// done
+bool NodeManager::CompactNode(Node &node, std::vector<bool> &bitmap, int32_t clusterBudget)
+{
+    auto fragments = node.GetFragments();
+    size_t fragmentCount = node.GetExtentCount();
+    auto clusterCount = node.GetClusterCount();
+
+    if (fragmentCount == 0) {
+        return false;
+    }
+
+    auto run = FindFreeRun(bitmap, clusterCount, 0);
+
+    if (run.start == FRAGMENT_UNUSED_START) {
+        return false;
+    }
+
+    if (fragmentCount == 1 && run.start > fragments.front().start) {
+        // the node is undivided and there is no free space before it
+        return false;
+    }
+
+    if (clusterCount > clusterBudget) {
+        return false;
+    }
+
+    MoveNode(node, run);
+
+    // keep the bitmap of the pass in sync with the partition
+    std::fill_n(bitmap.begin() + run.start, run.count, true);
+
+    for (auto &fragment : fragments) {
+        std::fill_n(bitmap.begin() + fragment.start, fragment.count, false);
+    }
+
+    return true;
+}
+
+// done
+std::vector<Node> NodeManager::GetAllNodes()
+{
+    std::unordered_map<int32_t, std::vector<MftItem>> nodeItems;
+    int32_t mftItemCount = m_partition.GetMftItemCount();
+
+    for (int32_t start = 0; start < mftItemCount; start += MFT_READ_CHUNK_SIZE) {
+        auto chunk = m_partition.ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
+
+        for (auto &item : chunk) {
+            if (item.item.uid != UID_ITEM_FREE) {
+                nodeItems[item.item.uid].emplace_back(item);
+            }
+        }
+    }
+
+    std::vector<Node> nodes;
+    nodes.reserve(nodeItems.size());
+
+    for (auto &entry : nodeItems) {
+        auto &items = entry.second;
+
+        std::sort(items.begin(), items.end(), [](const MftItem &item1, const MftItem &item2) {
+            return item1.item.order < item2.item.order;
+        });
+
+        nodes.emplace_back(Node{std::move(items)});
+    }
+
+    return nodes;
+}
+
+// done
+Node NodeManager::FindNode(int32_t uid, bool wholeMft)
 {
-    auto mftItems = m_partition.ReadMftItems(uid);
+    auto mftItems = m_partition.ReadMftItems(uid, wholeMft);
 
     if (mftItems.empty()) {
         throw NodeManagerNodeNotFoundException{"the node with the uid " + std::to_string(uid) + " doesn't exist"};
@@ -121,28 +275,270 @@ Node NodeManager::FindNode(int32_t uid)
     return Node{std::move(mftItems)};
 }
 
+// done
+Node NodeManager::FindNode(const NodeRef &ref)
+{
+    if (ref.IsResolved()) {
+        MftItem item = m_partition.ReadMftItem(ref.GetMftIndex());
+
+        if (item.item.uid == ref.GetUid() && item.item.order == 0 && item.item.count == 1) {
+            // the node is held by the one already known mft item
+            return Node{std::vector<MftItem>{item}};
+        }
+    }
+
+    return FindNode(ref.GetUid());
+}
+
+// done
+std::vector<NodeRef> NodeManager::FindNodes(const std::vector<int32_t> &uids)
+{
+    std::unordered_set<int32_t> wanted{uids.begin(), uids.end()};
+    std::unordered_map<int32_t, MftItem> found;
+    int32_t mftItemCount = m_partition.GetMftItemCount();
+
+    // sweep the mft once and pick the first mft items of the wanted nodes
+    for (int32_t start = 0; start < mftItemCount && found.size() < wanted.size(); start += MFT_READ_CHUNK_SIZE) {
+        auto chunk = m_partition.ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
+
+        for (auto &item : chunk) {
+            if (item.item.uid != UID_ITEM_FREE && item.item.order == 0 && wanted.find(item.item.uid) != wanted.end()) {
+                found.emplace(item.item.uid, item);
+            }
+        }
+    }
+
+    std::vector<NodeRef> refs;
+    refs.reserve(uids.size());
+
+    for (auto &uid : uids) {
+        auto itItem = found.find(uid);
+
+        if (itItem == found.end()) {
+            throw NodeManagerNodeNotFoundException{"the node with the uid " + std::to_string(uid) + " doesn't exist"};
+        }
+
+        refs.emplace_back(m_partition, itItem->second);
+    }
+
+    return refs;
+}
+
 // done
 void NodeManager::WriteIntoNode(const Node &node, void *source)
 {
-    m_partition.WriteClusters(node.GetClusters(), source, static_cast<size_t>(node.GetSize()));
+    auto src = static_cast<const char *>(source);
+    auto remaining = static_cast<size_t>(node.GetSize());
+    auto clusterSize = static_cast<size_t>(m_partition.GetClusterSize());
+
+    for (auto &extent : node.GetExtents()) {
+        if (remaining == 0) {
+            break;
+        }
+
+        size_t toWrite = std::min(remaining, extent.count * clusterSize);
+        m_partition.WriteClusterRun(extent.start, 0, src, toWrite);
+
+        src += toWrite;
+        remaining -= toWrite;
+    }
 }
 
 // done
 void NodeManager::WriteIntoNode(const Node &node, std::istream &source)
 {
-    m_partition.WriteClusters(node.GetClusters(), source, static_cast<size_t>(node.GetSize()));
+    auto remaining = static_cast<size_t>(node.GetSize());
+    auto clusterSize = static_cast<size_t>(m_partition.GetClusterSize());
+
+    // write the data through a bounded buffer
+    std::vector<char> buffer;
+    buffer.resize(std::min(remaining, COPY_BUFFER_CLUSTERS * clusterSize));
+
+    for (auto &extent : node.GetExtents()) {
+        size_t extentSize = extent.count * clusterSize;
+
+        for (size_t offset = 0; offset < extentSize && remaining > 0;) {
+            size_t toWrite = std::min({remaining, extentSize - offset, buffer.size()});
+
+            source.read(buffer.data(), toWrite);
+            m_partition.WriteClusterRun(extent.start, static_cast<int32_t>(offset), buffer.data(), toWrite);
+
+            offset += toWrite;
+            remaining -= toWrite;
+        }
+    }
+}
+
+// done
+void NodeManager::ImportIntoNode(const Node &node, int source)
+{
+    auto remaining = static_cast<size_t>(node.GetSize());
+    auto clusterSize = static_cast<size_t>(m_partition.GetClusterSize());
+
+    // copy inside the kernel while the source allows it
+    for (auto &extent : node.GetExtents()) {
+        if (remaining == 0) {
+            break;
+        }
+
+        size_t toWrite = std::min(remaining, extent.count * clusterSize);
+        size_t copied = m_partition.ImportClusterRun(extent.start, toWrite, source);
+
+        remaining -= copied;
+
+        if (copied < toWrite) {
+            break;
+        }
+    }
+
+    if (remaining == 0) {
+        return;
+    }
+
+    // read the rest in a separate thread, while the previous buffer is being written
+    ExtentMap extents{node};
+    auto offset = static_cast<int32_t>(node.GetSize() - remaining);
+
+    ImportPipeline pipeline{m_threadPool, source, remaining, IMPORT_BUFFER_SIZE, IMPORT_BUFFER_COUNT};
+
+    pipeline.Run([&](const char *data, size_t size) {
+        offset += WriteIntoNode(node, extents, offset, static_cast<int32_t>(size), data);
+    });
+}
+
+// done
+int32_t NodeManager::WriteIntoNode(const Node &node,
+                                   const ExtentMap &extents,
+                                   int32_t offset,
+                                   int32_t length,
+                                   const void *source)
+{
+    if (offset < 0 || length <= 0 || offset >= node.GetSize()) {
+        return 0;
+    }
+
+    auto src = static_cast<const char *>(source);
+    int32_t clusterSize = m_partition.GetClusterSize();
+    int32_t end = offset + std::min(length, node.GetSize() - offset);
+    int32_t position = offset;
+
+    // find the extent holding the first byte and write the following extents sequentially
+    for (size_t index = extents.FindExtent(offset / clusterSize);
+         position < end && index < extents.GetExtents().size();
+         index++) {
+
+        const mft_fragment &extent = extents.GetExtents()[index];
+        int32_t extentStart = extents.GetExtentOffset(index) * clusterSize;
+        int32_t extentEnd = extentStart + extent.count * clusterSize;
+
+        auto toWrite = std::min(end, extentEnd) - position;
+
+        m_partition.WriteClusterRun(extent.start, position - extentStart, src, static_cast<size_t>(toWrite));
+
+        position += toWrite;
+        src += toWrite;
+    }
+
+    return position - offset;
 }
 
 // done
 void NodeManager::ReadFromNode(const Node &node, void *destination)
 {
-    m_partition.ReadClusters(node.GetClusters(), destination, static_cast<size_t>(node.GetSize()));
+    auto dest = static_cast<char *>(destination);
+    auto remaining = static_cast<size_t>(node.GetSize());
+    auto clusterSize = static_cast<size_t>(m_partition.GetClusterSize());
+
+    for (auto &extent : node.GetExtents()) {
+        if (remaining == 0) {
+            break;
+        }
+
+        size_t toRead = std::min(remaining, extent.count * clusterSize);
+        m_partition.ReadClusterRun(extent.start, 0, dest, toRead);
+
+        dest += toRead;
+        remaining -= toRead;
+    }
+}
+
+// done
+int32_t NodeManager::ReadFromNode(const Node &node,
+                                  const ExtentMap &extents,
+                                  int32_t offset,
+                                  int32_t length,
+                                  void *destination)
+{
+    if (offset < 0 || length <= 0 || offset >= node.GetSize()) {
+        return 0;
+    }
+
+    auto dest = static_cast<char *>(destination);
+    int32_t clusterSize = m_partition.GetClusterSize();
+    int32_t end = offset + std::min(length, node.GetSize() - offset);
+    int32_t position = offset;
+
+    // find the extent holding the first byte and read the following extents sequentially
+    for (size_t index = extents.FindExtent(offset / clusterSize);
+         position < end && index < extents.GetExtents().size();
+         index++) {
+
+        const mft_fragment &extent = extents.GetExtents()[index];
+        int32_t extentStart = extents.GetExtentOffset(index) * clusterSize;
+        int32_t extentEnd = extentStart + extent.count * clusterSize;
+
+        auto toRead = std::min(end, extentEnd) - position;
+
+        m_partition.ReadClusterRun(extent.start, position - extentStart, dest, static_cast<size_t>(toRead));
+
+        position += toRead;
+        dest += toRead;
+    }
+
+    return position - offset;
 }
 
 // done
 void NodeManager::ReadFromNode(const Node &node, std::ostream &destination)
 {
-    m_partition.ReadClusters(node.GetClusters(), destination, static_cast<size_t>(node.GetSize()));
+    auto remaining = static_cast<size_t>(node.GetSize());
+    auto clusterSize = static_cast<size_t>(m_partition.GetClusterSize());
+
+    // read the data through a bounded buffer
+    std::vector<char> buffer;
+    buffer.resize(std::min(remaining, COPY_BUFFER_CLUSTERS * clusterSize));
+
+    for (auto &extent : node.GetExtents()) {
+        size_t extentSize = extent.count * clusterSize;
+
+        for (size_t offset = 0; offset < extentSize && remaining > 0;) {
+            size_t toRead = std::min({remaining, extentSize - offset, buffer.size()});
+
+            m_partition.ReadClusterRun(extent.start, static_cast<int32_t>(offset), buffer.data(), toRead);
+            destination.write(buffer.data(), toRead);
+
+            offset += toRead;
+            remaining -= toRead;
+        }
+    }
+}
+
+// done
+void NodeManager::ExportFromNode(const Node &node, int destination)
+{
+    auto remaining = static_cast<size_t>(node.GetSize());
+    auto clusterSize = static_cast<size_t>(m_partition.GetClusterSize());
+
+    for (auto &extent : node.GetExtents()) {
+        if (remaining == 0) {
+            break;
+        }
+
+        size_t toRead = std::min(remaining, extent.count * clusterSize);
+        m_partition.ExportClusterRun(extent.start, toRead, destination);
+
+        remaining -= toRead;
+    }
 }
 
 // done
@@ -172,7 +568,13 @@ int32_t NodeManager::GetFreeUid()
 }
 
 // done
-std::vector<mft_fragment> NodeManager::FindFreeFragments(int32_t size)
+int32_t NodeManager::GetClustersNeeded(int32_t size) const
+{
+    return size / m_partition.GetClusterSize() + 1;
+}
+
+// done
+std::vector<mft_fragment> NodeManager::FindFreeFragments(int32_t clusterCount, int32_t goal)
 {
     std::vector<mft_fragment> fragments;
 
@@ -181,110 +583,370 @@ std::vector<mft_fragment> NodeManager::FindFreeFragments(int32_t size)
         0
     };
 
-    int32_t clustersNeeded = size / m_partition.GetClusterSize() + 1;
+    auto bitmap = m_partition.ReadBitmap();
+    auto totalClusters = static_cast<int32_t>(bitmap.size());
+
+    if (goal < 0 || goal >= totalClusters) {
+        goal = 0;
+    }
 
     // first try to find one undivided fragment
-    // loop over all clusters
-    for (int32_t clusterIndex = 0; clusterIndex < m_partition.GetClusterCount(); clusterIndex++) {
+    fragment = FindFreeRun(bitmap, clusterCount, goal);
+
+    if (fragment.start != FRAGMENT_UNUSED_START) {
+        // succeeded to find undivided fragment
+
+        fragments.emplace_back(fragment);
+        return fragments;
+    }
+
+    // secondly try to find clusters divided into multiple fragments
+
+    int32_t foundClusters{0};
+    fragment.start = FRAGMENT_UNUSED_START;
+
+    for (int32_t i = 0; i < totalClusters; i++) {
+        int32_t clusterIndex = (goal + i) % totalClusters;
+
+        if (clusterIndex == 0 && fragment.start != FRAGMENT_UNUSED_START) {
+            // the fragment can't wrap around the end of the partition
+            fragments.emplace_back(fragment);
+
+            fragment.start = FRAGMENT_UNUSED_START;
+        }
 
-        if (!m_partition.ReadBitmapBit(clusterIndex)) {
+        if (bitmap[clusterIndex] == BIT_CLUSTER_FREE) {
             // cluster is free
 
             if (fragment.start == FRAGMENT_UNUSED_START) {
                 // looking for the first cluster of the fragment
 
                 fragment.start = clusterIndex;
+                fragment.count = 0;
             }
 
             fragment.count++;
+            foundClusters++;
         } else {
             // cluster is taken
 
-            fragment.start = FRAGMENT_UNUSED_START;
-            fragment.count = 0;
+            if (fragment.start != FRAGMENT_UNUSED_START) {
+
+                // reached end of one fragment
+                fragments.emplace_back(fragment);
+
+                fragment.start = FRAGMENT_UNUSED_START;
+            }
         }
 
-        if (fragment.count == clustersNeeded) {
-            // succeeded to find undivided fragment
+        if (foundClusters == clusterCount) {
+            // succeeded to find all clusters
+
+            // check whether the last fragment was added to the vector and add it eventually
+            if (fragment.start != FRAGMENT_UNUSED_START) {
+
+                fragments.emplace_back(fragment);
+            }
+
+            if (fragments.size() > GetMaxFragmentCount()) {
+                // too fragmented for the node mft items, take the largest fragments instead
+                return FindLargestFreeFragments(clusterCount);
+            }
 
-            fragments.emplace_back(fragment);
             return fragments;
         }
+
+        if (fragments.size() > GetMaxFragmentCount()) {
+            // too fragmented for the node mft items, take the largest fragments instead
+            return FindLargestFreeFragments(clusterCount);
+        }
     }
 
-    // secondly try to find clusters divided into multiple fragments
+    // the needed amount of clusters was not found
+    throw NodeManagerNotEnoughFreeClustersException{
+        "there are not enough free clusters for " + std::to_string(clusterCount) + " clusters"};
+}
 
-    int32_t foundClusters{0};
+// done
+mft_fragment NodeManager::FindFreeRun(const std::vector<bool> &bitmap, int32_t clusterCount, int32_t goal) const
+{
+    mft_fragment fragment{
+        FRAGMENT_UNUSED_START,
+        0
+    };
 
-    for (int32_t clusterIndex = 0; clusterIndex < m_partition.GetClusterCount(); clusterIndex++) {
+    auto totalClusters = static_cast<int32_t>(bitmap.size());
 
-        if (!m_partition.ReadBitmapBit(clusterIndex)) {
+    if (goal < 0 || goal >= totalClusters) {
+        goal = 0;
+    }
+
+    // loop over all clusters starting from the goal
+    for (int32_t i = 0; i < totalClusters; i++) {
+        int32_t clusterIndex = (goal + i) % totalClusters;
+
+        if (clusterIndex == 0) {
+            // the fragment can't wrap around the end of the partition
+            fragment.start = FRAGMENT_UNUSED_START;
+            fragment.count = 0;
+        }
+
+        if (bitmap[clusterIndex] == BIT_CLUSTER_FREE) {
             // cluster is free
 
-            if (fragment.start == -1) {
+            if (fragment.start == FRAGMENT_UNUSED_START) {
                 // looking for the first cluster of the fragment
 
                 fragment.start = clusterIndex;
-                fragment.count = 0;
             }
 
             fragment.count++;
-            foundClusters++;
         } else {
             // cluster is taken
 
-            if (fragment.start != -1) {
+            fragment.start = FRAGMENT_UNUSED_START;
+            fragment.count = 0;
+        }
 
-                // reached end of one fragment
-                fragments.emplace_back(fragment);
+        if (fragment.count == clusterCount) {
+            // succeeded to find undivided fragment
+            return fragment;
+        }
+    }
 
-                fragment.start = -1;
-            }
+    return mft_fragment{FRAGMENT_UNUSED_START, 0};
+}
+
+// done
+void NodeManager::MoveNode(Node &node, const mft_fragment &run)
+{
+    auto fragments = node.GetFragments();
+
+    // reserve the run and copy the node contents into it
+    m_partition.WriteBitmapRun(run.start, run.count, true);
+
+    CopyFragments(fragments, {run}, run.count);
+
+    // the first mft item holds the whole run, the others are released
+    std::vector<MftItem> releasedItems{node.m_mftItems.begin() + 1, node.m_mftItems.end()};
+    node.m_mftItems.resize(1);
+
+    SetupMftItems(node.m_mftItems, node.GetUid(), node.GetName(), node.IsDirectory(), node.GetSize(), {run});
+
+    std::vector<MftItem> changedItems{node.m_mftItems};
+
+    for (auto &item : releasedItems) {
+        item.item = mft_item{};
+        item.item.uid = UID_ITEM_FREE;
+
+        changedItems.emplace_back(item);
+    }
+
+    m_partition.WriteMftItems(changedItems);
+
+    // release the old clusters
+    for (auto &fragment : fragments) {
+        m_partition.WriteBitmapRun(fragment.start, fragment.count, false);
+    }
+}
+
+// done
+void NodeManager::CopyFragments(const std::vector<mft_fragment> &source,
+                                const std::vector<mft_fragment> &destination,
+                                int32_t clusterCount)
+{
+    size_t sourceIndex{0};
+    size_t destinationIndex{0};
+    int32_t sourceOffset{0};
+    int32_t destinationOffset{0};
+
+    // the pieces as the source start, the destination start and the count
+    std::vector<std::tuple<int32_t, int32_t, int32_t>> pieces;
+
+    while (clusterCount > 0 && sourceIndex < source.size() && destinationIndex < destination.size()) {
+        const mft_fragment &from = source[sourceIndex];
+        const mft_fragment &to = destination[destinationIndex];
+
+        // copy the longest part, that is consecutive in both fragments
+        int32_t count = std::min({from.count - sourceOffset, to.count - destinationOffset, clusterCount});
+
+        pieces.emplace_back(from.start + sourceOffset, to.start + destinationOffset, count);
+
+        sourceOffset += count;
+        destinationOffset += count;
+        clusterCount -= count;
+
+        if (sourceOffset == from.count) {
+            sourceIndex++;
+            sourceOffset = 0;
         }
 
-        if (foundClusters == clustersNeeded) {
-            // succeeded to find all clusters
+        if (destinationOffset == to.count) {
+            destinationIndex++;
+            destinationOffset = 0;
+        }
+    }
 
-            // check whether the last fragment was added to the vector and add it eventually
-            if (fragment.start != -1) {
+    // the pieces don't overlap, so they are copied in parallel
+    m_threadPool.ParallelFor(0, pieces.size(), 1, [this, &pieces](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            m_partition.CopyClusters(std::get<0>(pieces[i]), std::get<1>(pieces[i]), std::get<2>(pieces[i]));
+        }
+    });
+}
 
-                fragments.emplace_back(fragment);
+// done
+std::vector<mft_fragment> NodeManager::FindLargestFreeFragments(int32_t clusterCount)
+{
+    auto extents = FindFreeExtents(m_partition.ReadBitmap());
+
+    std::sort(extents.begin(), extents.end(), [](const mft_fragment &extent1, const mft_fragment &extent2) {
+        return extent1.count > extent2.count;
+    });
+
+    std::vector<mft_fragment> fragments;
+    int32_t foundClusters{0};
+
+    for (auto &extent : extents) {
+        if (foundClusters == clusterCount) {
+            break;
+        }
+
+        mft_fragment fragment{extent.start, std::min(extent.count, clusterCount - foundClusters)};
+
+        fragments.emplace_back(fragment);
+        foundClusters += fragment.count;
+    }
+
+    if (foundClusters < clusterCount) {
+        throw NodeManagerNotEnoughFreeClustersException{
+            "there are not enough free clusters for " + std::to_string(clusterCount) + " clusters"};
+    }
+
+    if (fragments.size() > GetMaxFragmentCount()) {
+        throw NodeManagerTooManyFragmentsException{
+            "the free space is too fragmented to store " + std::to_string(clusterCount) + " clusters in one node"};
+    }
+
+    // keep the clusters in the order they lay on the partition
+    std::sort(fragments.begin(), fragments.end(), [](const mft_fragment &fragment1, const mft_fragment &fragment2) {
+        return fragment1.start < fragment2.start;
+    });
+
+    return fragments;
+}
+
+// done
+std::vector<mft_fragment> NodeManager::FindFreeExtents(const std::vector<bool> &bitmap) const
+{
+    std::vector<mft_fragment> extents;
+
+    mft_fragment extent{
+        FRAGMENT_UNUSED_START,
+        0
+    };
+
+    for (int32_t clusterIndex = 0; clusterIndex < bitmap.size(); clusterIndex++) {
+
+        if (bitmap[clusterIndex] == BIT_CLUSTER_FREE) {
+            // cluster is free
+
+            if (extent.start == FRAGMENT_UNUSED_START) {
+                extent.start = clusterIndex;
+                extent.count = 0;
             }
 
-            return fragments;
+            extent.count++;
+        } else if (extent.start != FRAGMENT_UNUSED_START) {
+            // reached end of one extent
+
+            extents.emplace_back(extent);
+            extent.start = FRAGMENT_UNUSED_START;
         }
     }
 
-    // the needed amount of clusters was not found
-    throw NodeManagerNotEnoughFreeClustersException{
-        "there are not enough free clusters for the node of size " + std::to_string(size)};
+    if (extent.start != FRAGMENT_UNUSED_START) {
+        extents.emplace_back(extent);
+    }
+
+    return extents;
+}
+
+// done
+void NodeManager::NormalizeFragments(std::vector<mft_fragment> &fragments) const
+{
+    std::vector<mft_fragment> normalized;
+    normalized.reserve(fragments.size());
+
+    for (auto &fragment : fragments) {
+        if (fragment.start == FRAGMENT_UNUSED_START || fragment.count <= 0) {
+            continue;
+        }
+
+        if (!normalized.empty() && normalized.back().start + normalized.back().count == fragment.start) {
+            // the fragment continues the previous one
+            normalized.back().count += fragment.count;
+            continue;
+        }
+
+        normalized.emplace_back(fragment);
+    }
+
+    fragments = std::move(normalized);
+}
+
+// done
+int32_t NodeManager::GetMaxFragmentCount() const
+{
+    return MFT_ITEMS_PER_NODE_MAX * m_partition.GetMftMaxFragmentsCount();
 }
 
 // done
 std::vector<MftItem> NodeManager::FindFreeMftItems(size_t fragmentCount)
 {
     std::vector<MftItem> items;
+    std::vector<MftItem> run;
 
     auto itemsNeeded =
         static_cast<int32_t>(std::ceil(static_cast<double>(fragmentCount) / m_partition.GetMftMaxFragmentsCount()));
+    int32_t mftItemCount = m_partition.GetMftItemCount();
+
+    if (itemsNeeded > MFT_ITEMS_PER_NODE_MAX) {
+        throw NodeManagerTooManyFragmentsException{
+            "the " + std::to_string(fragmentCount) + " fragments don't fit into the mft items of one node"};
+    }
 
-    // loop over all items and find free
-    for (int i = 0; i < m_partition.GetMftItemCount(); i++) {
+    // loop over all items in chunks and find free
+    for (int32_t start = 0; start < mftItemCount; start += MFT_READ_CHUNK_SIZE) {
+        auto chunk = m_partition.ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
 
-        MftItem mftItem = m_partition.ReadMftItem(i);
+        for (auto &mftItem : chunk) {
 
-        // check if the item is free
-        if (mftItem.item.uid == UID_ITEM_FREE) {
+            // check if the item is free
+            if (mftItem.item.uid == UID_ITEM_FREE) {
 
-            items.emplace_back(mftItem);
-        }
+                run.emplace_back(mftItem);
 
-        if (items.size() == itemsNeeded) {
-            // all needed items found
-            return items;
+                if (items.size() < itemsNeeded) {
+                    items.emplace_back(mftItem);
+                }
+            } else {
+                // the run of consecutive free items is interrupted
+                run.clear();
+            }
+
+            if (run.size() == itemsNeeded) {
+                // all needed items found in one run
+                return run;
+            }
         }
     }
 
+    if (items.size() == itemsNeeded) {
+        // fall back to the first free items
+        return items;
+    }
+
     throw NodeManagerNotEnoughFreeMftItemsException{
         "there are not enough free mft items for the " + std::to_string(fragmentCount) + " fragments"};
 }
@@ -295,8 +957,16 @@ void NodeManager::SetupMftItems(std::vector<MftItem> &mftItems,
                                 std::string name,
                                 bool isDirectory,
                                 int32_t size,
-                                const std::vector<mft_fragment> &fragments)
+                                std::vector<mft_fragment> fragments)
 {
+    NormalizeFragments(fragments);
+
+    if (fragments.size() > mftItems.size() * m_partition.GetMftMaxFragmentsCount()
+        || mftItems.size() > MFT_ITEMS_PER_NODE_MAX) {
+        throw NodeManagerTooManyFragmentsException{
+            "the " + std::to_string(fragments.size()) + " fragments don't fit into the node mft items"};
+    }
+
     int8_t itemOrder = 0;
     int32_t fragmentsWritten = 0;
 
@@ -332,5 +1002,5 @@ void NodeManager::SetupMftItems(std::vector<MftItem> &mftItems,
 // done
 int32_t NodeManager::GetNodeCapacity(const Node &node) const
 {
-    return static_cast<int32_t>(node.GetClusters().size() * m_partition.GetClusterSize());
+    return node.GetClusterCount() * m_partition.GetClusterSize();
 }
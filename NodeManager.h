@@ -2,9 +2,15 @@
 
 #include <cstdint>
 #include <istream>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "Partition.h"
 #include "Node.h"
+#include "NodeRef.h"
+#include "ExtentMap.h"
+#include "ImportPipeline.h"
+#include "ThreadPool.h"
 
 /**
  * The class NodeManager handles the ntfs nodes creation and destruction
@@ -18,8 +24,9 @@ public:
      * Initializes a new NodeManager, that will opperate on the given partition.
      *
      * @param partition The ntfs partiton.
+     * @param threadPool The thread pool for the parallel work.
      */
-    explicit NodeManager(Partition &partition);
+    NodeManager(Partition &partition, ThreadPool &threadPool);
 
     /**
      * Get the nodes clusters total capacity.
@@ -37,13 +44,15 @@ public:
      * @param name The name of the node (max 11 characters).
      * @param isDirectory True if so, false otherwise.
      * @param size The size of the node content in bytes.
+     * @param goal The cluster near which the node clusters should be placed,
+     *             negative to search for them from the partition start.
      *
      * @throws NodeManagerNotEnoughFreeClustersException When there are not enough free clusters for the node of the given size.
      * @throws NodeManagerNotEnoughFreeMftItemsException When there are not enough free mft items for the number of fragments required by the node.
      *
      * @return The created node.
      */
-    Node CreateNode(std::string name, bool isDirectory, int32_t size);
+    Node CreateNode(std::string name, bool isDirectory, int32_t size, int32_t goal = -1);
 
     /**
      * Write the node mft items to partition and mark the node clusters
@@ -55,21 +64,26 @@ public:
 
     /**
      * Mark the given node mft items and clusters as free on the partition.
+     * The empty node, which was never created, is ignored.
      *
      * @param node The node to be released.
      */
     void ReleaseNode(const Node &node);
 
     /**
-     * Try to acquire resources for the new size of the node.
-     * If the current node capacity is sufficient
-     * and isn't unnecessarily big, the node remains unchanged.
+     * Resize the node in place, its contents are kept.
+     * When the node grows, free clusters are appended behind its last cluster if possible,
+     * when it shrinks, the clusters behind its new end are released.
+     * If the grown node wouldn't fit into the mft items, it is relocated
+     * into the fewest possible runs of free clusters.
+     * If the resources can't be acquired, the node remains unchanged.
      *
      * @param node The node to be resized.
      * @param size The new size of the node contents.
      *
      * @throws NodeManagerNotEnoughFreeClustersException When there are not enough free clusters for the new size.
      * @throws NodeManagerNotEnoughFreeMftItemsException When there are not enough free mft items for the fragments.
+     * @throws NodeManagerTooManyFragmentsException When the free space is too fragmented for the new size.
      */
     void ResizeNode(Node &node, int32_t size);
 
@@ -84,28 +98,91 @@ public:
     /**
      * Clone the given node into a new node with a different uid and own name.
      * Allocates resources for the new node and copies the cloned node
-     * properties and its contents.
+     * properties and its contents extent by extent inside the partition,
+     * so the contents are never held in memory as a whole.
      *
      * @param node The node to be cloned.
      * @param name The name of the clone.
+     * @param goal The cluster near which the clone clusters should be placed,
+     *             negative to search for them from the partition start.
      *
      * @throws NodeManagerNotEnoughFreeClustersException When there are not enough free clusters for the clone.
      * @throws NodeManagerNotEnoughFreeMftItemsException When there are not enough free mft items for the number of fragments required by the clone.
      *
      * @return The new node with own uid - clone of the given node.
      */
-    Node CloneNode(const Node &node, std::string name);
+    Node CloneNode(const Node &node, std::string name, int32_t goal = -1);
+
+    /**
+     * Move the node clusters into one undivided run of free clusters.
+     * The data are copied first, then the node mft items are rewritten
+     * in one write (if they are consecutive) and finally the old clusters
+     * are released, so the node stays consistent if the relocation is interrupted.
+     *
+     * @param node The node to be relocated.
+     * @param goal The cluster where the search for the free run starts,
+     *             negative to start near the current node clusters.
+     *
+     * @return True if the node was relocated, false if there is no sufficient run of free clusters.
+     */
+    bool RelocateNode(Node &node, int32_t goal = -1);
+
+    /**
+     * Move the node into the first run of free clusters, that is sufficient for it,
+     * if the node is fragmented or the run lies before the node.
+     * The node is moved the same way as by the RelocateNode function.
+     *
+     * @param node The node to be compacted.
+     * @param bitmap The cluster bitmap read once for the whole pass, it is updated by the move.
+     * @param clusterBudget The max number of clusters which may be moved.
+     *
+     * @return True if the node was moved, false if it needn't, can't or mustn't be moved.
+     */
+    bool CompactNode(Node &node, std::vector<bool> &bitmap, int32_t clusterBudget);
+
+    /**
+     * Load all nodes present on the partition in one pass over the mft.
+     *
+     * @return The vector of all nodes.
+     */
+    std::vector<Node> GetAllNodes();
 
     /**
      * Find the node with the given uid.
      *
      * @param uid The uid of the node.
+     * @param wholeMft Whether to scan the whole mft for the node items, see Partition::ReadMftItems.
      *
      * @throws NodeManagerNodeNotFoundException When the file with the given uid doesn't exist.
      *
      * @return The found node.
      */
-    Node FindNode(int32_t uid);
+    Node FindNode(int32_t uid, bool wholeMft = false);
+
+    /**
+     * Find the node referenced by the given node handle.
+     * If the handle knows the index of the first node mft item
+     * and the node has only that one, nothing else is read from the mft.
+     *
+     * @param ref The node handle.
+     *
+     * @throws NodeManagerNodeNotFoundException When the referenced node doesn't exist.
+     *
+     * @return The found node.
+     */
+    Node FindNode(const NodeRef &ref);
+
+    /**
+     * Find the nodes with the given uids in one pass over the mft.
+     * The returned handles have the node metadata already loaded.
+     *
+     * @param uids The uids of the nodes.
+     *
+     * @throws NodeManagerNodeNotFoundException When some of the nodes doesn't exist.
+     *
+     * @return The node handles in the order of the given uids.
+     */
+    std::vector<NodeRef> FindNodes(const std::vector<int32_t> &uids);
 
     /**
      * Write data from the given source into the partition clusters owned by the given node.
@@ -125,6 +202,34 @@ public:
      */
     void WriteIntoNode(const Node &node, std::istream &source);
 
+    /**
+     * Copy the data from the file descriptor into the given node extent by extent.
+     * The size of the data is determined by the node size.
+     * When the kernel can't copy from the source, the rest is read by the ImportPipeline
+     * and written into the node as the buffers are filled.
+     *
+     * @param node The node which contents will be written into.
+     * @param source The source file descriptor.
+     *
+     * @throws PartitionTransferException When the copying fails or the source ends too early.
+     */
+    void ImportIntoNode(const Node &node, int source);
+
+    /**
+     * Write the data from the given source into the part of the node contents.
+     * Only the clusters holding the written part are written.
+     * The data behind the node size are not written.
+     *
+     * @param node The node which contents will be written into.
+     * @param extents The extent map of the node.
+     * @param offset The offset of the data in bytes from the start of the node contents.
+     * @param length The number of bytes to be written.
+     * @param source The pointer to the data source.
+     *
+     * @return The number of bytes written.
+     */
+    int32_t WriteIntoNode(const Node &node, const ExtentMap &extents, int32_t offset, int32_t length, const void *source);
+
     /**
      * Read data from the partition clusters owned by the given node into the given destination.
      * The size of the data is determined by the node size.
@@ -134,6 +239,20 @@ public:
      */
     void ReadFromNode(const Node &node, void *destination);
 
+    /**
+     * Read the part of the node contents into the given destination.
+     * Only the clusters holding the requested part are read.
+     *
+     * @param node The node which contents will be read.
+     * @param extents The extent map of the node.
+     * @param offset The offset of the data in bytes from the start of the node contents.
+     * @param length The max number of bytes to be read.
+     * @param destination The pointer to the data destination.
+     *
+     * @return The number of bytes read, it is lower than the length if the end of the node contents is reached.
+     */
+    int32_t ReadFromNode(const Node &node, const ExtentMap &extents, int32_t offset, int32_t length, void *destination);
+
     /**
      * Read data from the partition clusters owned by the given node into the given output stream.
      * The size of the data is determined by the node size.
@@ -143,12 +262,28 @@ public:
      */
     void ReadFromNode(const Node &node, std::ostream &destination);
 
+    /**
+     * Copy the contents of the given node into the file descriptor extent by extent.
+     * The size of the data is determined by the node size.
+     *
+     * @param node The node which contents will be copied.
+     * @param destination The destination file descriptor.
+     *
+     * @throws PartitionTransferException When the copying fails.
+     */
+    void ExportFromNode(const Node &node, int destination);
+
 private:
     /**
      * The ntfs partition on which will this node manager operate.
      */
     Partition &m_partition;
 
+    /**
+     * The thread pool for the parallel work.
+     */
+    ThreadPool &m_threadPool;
+
     /**
      * Get a free unique id within the partition mft.
      *
@@ -157,19 +292,110 @@ private:
     int32_t GetFreeUid();
 
     /**
-     * Find sufficient amount of free clusters for the node of the given size.
+     * Get the number of clusters needed for the node contents of the given size.
+     *
+     * @param size The size of the node contents in bytes.
+     *
+     * @return The number of clusters.
+     */
+    int32_t GetClustersNeeded(int32_t size) const;
+
+    /**
+     * Get the max number of fragments, that can be stored in the mft items of one node.
+     *
+     * @return The max number of fragments.
+     */
+    int32_t GetMaxFragmentCount() const;
+
+    /**
+     * Find the given amount of free clusters.
      * First tries to find one undivided fragment, if it fails, tries to find
      * free clusters in multiple fragments.
+     * The search starts on the goal cluster and wraps around the end of the partition.
+     * If the found fragments wouldn't fit into the mft items of one node,
+     * falls back to the largest free fragments.
+     *
+     * @param clusterCount The number of clusters to be found.
+     * @param goal The index of the cluster where the search starts.
+     *
+     * @throws NodeManagerNotEnoughFreeClustersException When there are not enough free clusters.
+     * @throws NodeManagerTooManyFragmentsException When even the largest free fragments don't fit into the mft items of one node.
      *
-     * @param size The minimal capacity of found clusters.
      * @return The vector of free fragments.
      */
-    std::vector<mft_fragment> FindFreeFragments(int32_t size);
+    std::vector<mft_fragment> FindFreeFragments(int32_t clusterCount, int32_t goal);
+
+    /**
+     * Find one undivided run of the given amount of free clusters.
+     * The search starts on the goal cluster and wraps around the end of the partition.
+     *
+     * @param bitmap The partition bitmap.
+     * @param clusterCount The number of clusters to be found.
+     * @param goal The index of the cluster where the search starts.
+     *
+     * @return The found run or the fragment with start FRAGMENT_UNUSED_START if there is no such run.
+     */
+    mft_fragment FindFreeRun(const std::vector<bool> &bitmap, int32_t clusterCount, int32_t goal) const;
+
+    /**
+     * Move the node contents into the given run of free clusters,
+     * rewrite its mft items and release its old clusters.
+     *
+     * @param node The node to be moved.
+     * @param run The run of free clusters, that is big enough for the node contents.
+     */
+    void MoveNode(Node &node, const mft_fragment &run);
+
+    /**
+     * Copy the contents of the source clusters into the destination clusters.
+     * Both fragment lists are walked in their order.
+     *
+     * @param source The source fragments.
+     * @param destination The destination fragments.
+     * @param clusterCount The number of clusters to be copied.
+     */
+    void CopyFragments(const std::vector<mft_fragment> &source, const std::vector<mft_fragment> &destination, int32_t clusterCount);
+
+    /**
+     * Find the given amount of free clusters in the fewest possible fragments
+     * by taking the largest free fragments first.
+     *
+     * @param clusterCount The number of clusters to be found.
+     *
+     * @throws NodeManagerNotEnoughFreeClustersException When there are not enough free clusters.
+     * @throws NodeManagerTooManyFragmentsException When the fragments don't fit into the mft items of one node.
+     *
+     * @return The vector of free fragments sorted by their start.
+     */
+    std::vector<mft_fragment> FindLargestFreeFragments(int32_t clusterCount);
+
+    /**
+     * Find all the runs of free clusters in the given bitmap.
+     *
+     * @param bitmap The partition bitmap.
+     *
+     * @return The vector of free fragments sorted by their start.
+     */
+    std::vector<mft_fragment> FindFreeExtents(const std::vector<bool> &bitmap) const;
+
+    /**
+     * Merge the adjacent fragments in the given fragment list
+     * and remove the empty ones. The order of the fragments is kept.
+     *
+     * @param fragments The fragments to be normalized.
+     */
+    void NormalizeFragments(std::vector<mft_fragment> &fragments) const;
 
     /**
      * Find sufficient amount of free mft items for the given number of fragments.
+     * Prefers the consecutive mft items, so the node can be loaded by one read.
+     * If there is no such run of free items, the first free items are used.
      *
      * @param fragmentCount The number of fragments that must fit into the mft items.
+     *
+     * @throws NodeManagerTooManyFragmentsException When the fragments don't fit into the mft items of one node.
+     * @throws NodeManagerNotEnoughFreeMftItemsException When there are not enough free mft items.
+     *
      * @return The found free mft items.
      */
     std::vector<MftItem> FindFreeMftItems(size_t fragmentCount);
@@ -178,6 +404,7 @@ private:
      * Set the values of mft items according the to given node properties, fill them
      * with the given fragments, set appropriate order and count of the mft items
      * and sort the by their order.
+     * The fragments are normalized before they are written.
      *
      * @param mftItems The mft items to be set up.
      * @param uid The uid of node.
@@ -185,6 +412,8 @@ private:
      * @param isDirectory True if the node is a directory, false if it's a file.
      * @param size The size of the node contents.
      * @param fragments The node fragments.
+     *
+     * @throws NodeManagerTooManyFragmentsException When the fragments don't fit into the given mft items.
      */
-    void SetupMftItems(std::vector<MftItem>& mftItems, int32_t uid, std::string name, bool isDirectory, int32_t size, const std::vector<mft_fragment> &fragments);
+    void SetupMftItems(std::vector<MftItem>& mftItems, int32_t uid, std::string name, bool isDirectory, int32_t size, std::vector<mft_fragment> fragments);
 };
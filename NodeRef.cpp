@@ -0,0 +1,106 @@
+#include <cstring>
+
+#include "NodeRef.h"
+#include "Exceptions/NodeExceptions.h"
+
+// done
+NodeRef::NodeRef(Partition &partition, int32_t uid, int32_t mftIndex)
+    : m_partition{&partition},
+      m_uid{uid},
+      m_mftIndex{mftIndex},
+      m_loaded{false},
+      m_name{},
+      m_isDirectory{false},
+      m_size{0}
+{}
+
+// done
+NodeRef::NodeRef(Partition &partition, const Node &node)
+    : NodeRef{partition, node.GetUid()}
+{
+    Load(node.GetMftItems().front());
+}
+
+// done
+NodeRef::NodeRef(Partition &partition, const MftItem &item)
+    : NodeRef{partition, item.item.uid}
+{
+    Load(item);
+}
+
+// done
+int32_t NodeRef::GetUid() const
+{
+    return m_uid;
+}
+
+// done
+bool NodeRef::IsResolved() const
+{
+    return m_mftIndex != MFT_INDEX_UNKNOWN;
+}
+
+// done
+int32_t NodeRef::GetMftIndex() const
+{
+    if (!IsResolved()) {
+        m_mftIndex = m_partition->FindMftItem(m_uid);
+    }
+
+    if (!IsResolved()) {
+        throw NodeNotFoundException{"the node with the uid " + std::to_string(m_uid) + " doesn't exist"};
+    }
+
+    return m_mftIndex;
+}
+
+// done
+std::string NodeRef::GetName() const
+{
+    Load();
+
+    return m_name;
+}
+
+// done
+bool NodeRef::IsDirectory() const
+{
+    Load();
+
+    return m_isDirectory;
+}
+
+// done
+int32_t NodeRef::GetSize() const
+{
+    Load();
+
+    return m_size;
+}
+
+// done
+void NodeRef::Load() const
+{
+    if (m_loaded) {
+        return;
+    }
+
+    MftItem item = m_partition->ReadMftItem(GetMftIndex());
+
+    if (item.item.uid != m_uid) {
+        throw NodeNotFoundException{"the node with the uid " + std::to_string(m_uid) + " doesn't exist"};
+    }
+
+    Load(item);
+}
+
+// done
+void NodeRef::Load(const MftItem &item) const
+{
+    m_mftIndex = item.index;
+    std::strncpy(m_name, item.item.name, NODE_NAME_SIZE - 1);
+    m_name[NODE_NAME_SIZE - 1] = '\0';
+    m_isDirectory = item.item.is_directory;
+    m_size = item.item.size;
+    m_loaded = true;
+}
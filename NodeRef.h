@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "NtfsStructs.h"
+#include "Partition.h"
+#include "Node.h"
+
+/**
+ * Class NodeRef is a lightweight handle of a ntfs node.
+ * It holds only the node uid and the index of its first mft item,
+ * the node name, type and size are read from the partition
+ * when they are needed for the first time.
+ * The whole node with its fragments is found by the NodeManager.
+ */
+class NodeRef
+{
+public:
+    /**
+     * Initialize a new NodeRef of the node with the given uid.
+     *
+     * @param partition The partition the node lies on.
+     * @param uid The uid of the node.
+     * @param mftIndex The index of the first node mft item or MFT_INDEX_UNKNOWN if it is not known yet.
+     */
+    NodeRef(Partition &partition, int32_t uid, int32_t mftIndex = MFT_INDEX_UNKNOWN);
+
+    /**
+     * Initialize a new NodeRef of the given node.
+     * The node metadata are taken from the node, so nothing is read from the partition.
+     *
+     * @param partition The partition the node lies on.
+     * @param node The node.
+     */
+    NodeRef(Partition &partition, const Node &node);
+
+    /**
+     * Initialize a new NodeRef of the node with the given first mft item.
+     * The node metadata are taken from the item, so nothing is read from the partition.
+     *
+     * @param partition The partition the node lies on.
+     * @param item The first mft item of the node.
+     */
+    NodeRef(Partition &partition, const MftItem &item);
+
+    /**
+     * Get the node uid.
+     *
+     * @return The uid.
+     */
+    int32_t GetUid() const;
+
+    /**
+     * Check whether the index of the first node mft item is already known.
+     *
+     * @return True if so, false otherwise.
+     */
+    bool IsResolved() const;
+
+    /**
+     * Get the index of the first node mft item.
+     *
+     * @throws NodeNotFoundException When the node doesn't exist.
+     *
+     * @return The mft item index.
+     */
+    int32_t GetMftIndex() const;
+
+    /**
+     * Get the node name.
+     *
+     * @throws NodeNotFoundException When the node doesn't exist.
+     *
+     * @return The name.
+     */
+    std::string GetName() const;
+
+    /**
+     * Check whether the node is a directory or a file.
+     *
+     * @throws NodeNotFoundException When the node doesn't exist.
+     *
+     * @return True if it's a directory, false if it's a file.
+     */
+    bool IsDirectory() const;
+
+    /**
+     * Get the node size.
+     *
+     * @throws NodeNotFoundException When the node doesn't exist.
+     *
+     * @return Size in bytes.
+     */
+    int32_t GetSize() const;
+
+private:
+    /**
+     * The partition the node lies on.
+     */
+    Partition *m_partition;
+
+    /**
+     * The uid of the node.
+     */
+    int32_t m_uid;
+
+    /**
+     * The index of the first node mft item or MFT_INDEX_UNKNOWN.
+     */
+    mutable int32_t m_mftIndex;
+
+    /**
+     * Whether the node metadata are already loaded.
+     */
+    mutable bool m_loaded;
+
+    /**
+     * The cached node name.
+     */
+    mutable char m_name[NODE_NAME_SIZE];
+
+    /**
+     * The cached node type.
+     */
+    mutable bool m_isDirectory;
+
+    /**
+     * The cached node size.
+     */
+    mutable int32_t m_size;
+
+    /**
+     * Load the node metadata from its first mft item if they aren't loaded yet.
+     *
+     * @throws NodeNotFoundException When the node doesn't exist.
+     */
+    void Load() const;
+
+    /**
+     * Cache the node metadata from its first mft item.
+     *
+     * @param item The first mft item of the node.
+     */
+    void Load(const MftItem &item) const;
+};
@@ -1,103 +1,120 @@
-#include <thread>
-#include <sstream>
+#include <algorithm>
 
 #include "NodeSizeChecker.h"
+#include "NodeInvariants.h"
 
 // done
 NodeSizeChecker::NodeSizeChecker(Ntfs &ntfs, std::ostream &output)
     : m_ntfs(ntfs),
-      m_output(output),
-      m_mftItemCount(ntfs.m_partition.GetMftItemCount())
+      m_output(output)
 {}
 
 // done
-bool NodeSizeChecker::Run(size_t threadCount)
+bool NodeSizeChecker::Run()
 {
-    m_nextMftItemIndex = 0;
-    m_checkedNodes.clear();
-    m_success = true;
+    m_mft = m_ntfs.m_partition.ReadMftRange(0, m_ntfs.m_partition.GetMftItemCount());
 
-    std::vector<std::thread> threads;
-    threads.reserve(threadCount);
+    size_t rangeCount = std::max(std::min(m_ntfs.m_threadPool.GetThreadCount(), m_mft.size()), size_t{1});
+    size_t rangeSize = std::max((m_mft.size() + rangeCount - 1) / rangeCount, size_t{1});
 
-    for (int i = 0; i < threadCount; i++) {
-        std::thread thread{&NodeSizeChecker::RunSubChecker, this};
+    std::vector<NodeStatsMap> partialStats{rangeCount};
 
-        threads.push_back(std::move(thread));
+    // every task collects the nodes of its own range of the mft
+    m_ntfs.m_threadPool.ParallelFor(0, m_mft.size(), rangeSize, [this, rangeSize, &partialStats](size_t begin, size_t end) {
+        CollectStats(begin, end, partialStats[begin / rangeSize]);
+    });
+
+    NodeStatsMap stats;
+
+    for (auto &partial : partialStats) {
+        MergeStats(partial, stats);
     }
 
-    for (auto &thread : threads) {
-        thread.join();
+    // check the nodes in the order of their mft items
+    std::vector<std::pair<int32_t, NodeStats>> nodes{stats.begin(), stats.end()};
+
+    std::sort(nodes.begin(), nodes.end(), [](const std::pair<int32_t, NodeStats> &node1,
+                                             const std::pair<int32_t, NodeStats> &node2) {
+        return node1.second.firstIndex < node2.second.firstIndex;
+    });
+
+    bool success = true;
+
+    for (auto &node : nodes) {
+        success = CheckNode(node.first, node.second) && success;
     }
 
-    return m_success;
+    m_mft.clear();
+    m_mft.shrink_to_fit();
+
+    return success;
 }
 
 // done
-std::unique_ptr<Node> NodeSizeChecker::GetNextNode()
+void NodeSizeChecker::CollectStats(size_t begin, size_t end, NodeStatsMap &stats) const
 {
-    std::unique_lock<std::mutex> lock{m_mutexGetFile};
-
-    while (true) {
-        if (m_nextMftItemIndex >= m_mftItemCount) {
-            return nullptr;
-        }
+    for (size_t index = begin; index < end; index++) {
+        const mft_item &item = m_mft[index].item;
 
-        MftItem item = m_ntfs.m_partition.ReadMftItem(m_nextMftItemIndex);
-        m_nextMftItemIndex++;
-
-        if (item.item.uid == UID_ITEM_FREE) {
+        if (item.uid == UID_ITEM_FREE) {
             continue;
         }
 
-        if (m_checkedNodes.find(item.item.uid) == m_checkedNodes.end()) {
+        auto inserted = stats.emplace(item.uid, NodeStats{m_mft[index].index, 0, 0});
+        NodeStats &node = inserted.first->second;
 
-            m_checkedNodes.emplace(item.item.uid);
+        if (item.order == 0) {
+            node.size = item.size;
+        }
 
-            return std::make_unique<Node>(m_ntfs.m_nodeManager.FindNode(item.item.uid));
+        for (int i = 0; i < MFT_FRAGMENTS_COUNT && item.fragments[i].start != FRAGMENT_UNUSED_START; i++) {
+            node.clusterCount += item.fragments[i].count;
         }
     }
 }
 
 // done
-void NodeSizeChecker::PrintMessage(const std::string &message)
+void NodeSizeChecker::MergeStats(const NodeStatsMap &partial, NodeStatsMap &total) const
 {
-    std::unique_lock<std::mutex> lock{m_mutexPrintMessage};
+    for (auto &entry : partial) {
+        auto inserted = total.emplace(entry);
 
-    m_output << message;
+        if (inserted.second) {
+            continue;
+        }
+
+        NodeStats &node = inserted.first->second;
+        node.firstIndex = std::min(node.firstIndex, entry.second.firstIndex);
+        node.size = std::max(node.size, entry.second.size);
+        node.clusterCount += entry.second.clusterCount;
+    }
 }
 
 // done
-void NodeSizeChecker::RunSubChecker()
+bool NodeSizeChecker::CheckNode(int32_t uid, const NodeStats &stats)
 {
-    while (true) {
-        auto node = GetNextNode();
+    int comparison = NodeInvariants::CompareClustersWithSize(
+        stats.clusterCount, stats.size, m_ntfs.m_partition.GetClusterSize());
 
-        if (node == nullptr) {
-            return;
-        }
+    if (comparison < 0) {
+        m_output
+            << "WARNING: the node " << uid
+            << " has " << stats.clusterCount << " clusters - "
+            << "fewer than is needed for the node size " << stats.size << " bytes"
+            << std::endl;
 
-        auto clusters = node->GetClusters();
+        return false;
+    }
 
-        if (clusters.size() * m_ntfs.m_partition.GetClusterSize() < node->GetSize()) {
-            std::stringstream ss;
-            ss
-                << "WARNING: the node " << node->GetUid()
-                << " has " << clusters.size() << " clusters - "
-                << "fewer than is needed for the node size " << node->GetSize() << " bytes"
-                << std::endl;
+    if (comparison > 0) {
+        m_output
+            << "WARNING: the node " << uid
+            << " has " << stats.clusterCount << " clusters - "
+            << "more than is needed for the node size " << stats.size << " bytes"
+            << std::endl;
 
-            PrintMessage(ss.str());
-        }
-        else if ((clusters.size() - 1) * m_ntfs.m_partition.GetClusterSize() > node->GetSize()) {
-            std::stringstream ss;
-            ss
-                << "WARNING: the node " << node->GetUid()
-                << " has " << clusters.size() << " clusters - "
-                << "more than is needed for the node size " << node->GetSize() << " bytes"
-                << std::endl;
-
-            PrintMessage(ss.str());
-        }
+        return false;
     }
+
+    return true;
 }
@@ -1,9 +1,7 @@
 #pragma once
 
-#include <mutex>
-#include <unordered_set>
-#include <atomic>
-#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "Ntfs.h"
 
@@ -26,75 +24,68 @@ public:
      * Checks every node on the partition,
      * if its size corresponds with the
      * number of clusters assigned for it.
-     *
-     * @param threadCount The number of threads to use for checking.
+     * The mft is read once, every task of the thread pool counts the clusters
+     * of the mft items in its own range of indexes and the counts are merged.
      *
      * @return True if everything is OK, false otherwise.
      */
-    bool Run(size_t threadCount);
+    bool Run();
 
 private:
     /**
-     * The ntfs which this checker operates on.
-     */
-    Ntfs &m_ntfs;
-
-    /**
-     * The output to print messages.
-     */
-    std::ostream &m_output;
-
-    /**
-     * The mutex to block multiple threads
-     * to access the GetNextFile function concurrently.
+     * The structure of the node properties collected from its mft items.
      */
-    std::mutex m_mutexGetFile;
+    struct NodeStats
+    {
+        int32_t firstIndex;                             // the lowest index of the node mft items
+        int32_t size;                                   // the node size taken from its first mft item
+        int32_t clusterCount;                           // the number of the clusters in the collected mft items
+    };
 
     /**
-     * The mutex to block multiple threads
-     * to access the PrintMessage function concurrently.
+     * The map of the node properties by the node uids.
      */
-    std::mutex m_mutexPrintMessage;
+    typedef std::unordered_map<int32_t, NodeStats> NodeStatsMap;
 
     /**
-     * The number of mft items present on the partition.
-     */
-    int32_t m_mftItemCount;
-
-    /**
-     * Indicates whether the nodes check succeeded.
+     * The ntfs which this checker operates on.
      */
-    std::atomic<bool> m_success;
+    Ntfs &m_ntfs;
 
     /**
-     * The index of the next mft item to be processed
+     * The output to print messages.
      */
-    int32_t m_nextMftItemIndex;
+    std::ostream &m_output;
 
     /**
-     * The set of uids of already checked nodes.
+     * The snapshot of the whole mft.
      */
-    std::unordered_set<int32_t> m_checkedNodes;
+    std::vector<MftItem> m_mft;
 
     /**
-     * Get the next node to process;
+     * Collect the properties of the nodes from the mft items in the given range of the snapshot.
      *
-     * @return The next node to check of the node to check, nullptr if there are no more nodes to check.
+     * @param begin The index of the first mft item.
+     * @param end The index behind the last mft item.
+     * @param stats The map to collect the properties into.
      */
-    std::unique_ptr<Node> GetNextNode();
+    void CollectStats(size_t begin, size_t end, NodeStatsMap &stats) const;
 
     /**
-     * Print message into the output.
+     * Merge the properties collected by one task into the total ones.
      *
-     * @param message The message.
+     * @param partial The properties collected by one task.
+     * @param total The total properties.
      */
-    void PrintMessage(const std::string &message);
+    void MergeStats(const NodeStatsMap &partial, NodeStatsMap &total) const;
 
     /**
-     * Run the function that repeatedly asks for a node to check
-     * and checks its size.
+     * Check whether the node size corresponds with its number of clusters.
+     *
+     * @param uid The uid of the node.
+     * @param stats The properties of the node.
+     *
+     * @return True if it does, false otherwise.
      */
-    void RunSubChecker();
+    bool CheckNode(int32_t uid, const NodeStats &stats);
 };
-
-
@@ -5,32 +5,67 @@
 #include "Ntfs.h"
 #include "Exceptions/NtfsExceptions.h"
 #include "Exceptions/NodeManagerExceptions.h"
+#include "Exceptions/PartitionExceptions.h"
+
+namespace
+{
+    /**
+     * The working directory of the session bound to the current thread, null outside the sessions.
+     */
+    thread_local int32_t *sessionDirectory{nullptr};
+
+    /**
+     * The session bound to the current thread.
+     */
+    thread_local int32_t sessionId{SESSION_DEFAULT};
+}
 
 //done
-Ntfs::Ntfs(std::string partitionPath)
+Ntfs::Ntfs(std::string partitionPath, ThreadPool &threadPool)
     : m_partition{std::move(partitionPath)},
-      m_nodeManager{m_partition},
+      m_threadPool(threadPool),
+      m_nodeManager{m_partition, m_threadPool},
       m_currentDirectory{UID_ROOT}
 {}
 
+// done
+Ntfs::SessionScope::SessionScope(int32_t session, int32_t &currentDirectory)
+    : m_previousSession{sessionId},
+      m_previousDirectory{sessionDirectory}
+{
+    sessionId = session;
+    sessionDirectory = &currentDirectory;
+}
+
+// done
+Ntfs::SessionScope::~SessionScope()
+{
+    sessionId = m_previousSession;
+    sessionDirectory = m_previousDirectory;
+}
+
 // done
 bool Ntfs::IsOpened()
 {
+    SharedLock lock{m_metadataMutex};
+
     return m_partition.IsOpened();
 }
 
 // done
 std::string Ntfs::Pwd()
 {
+    SharedLock lock{m_metadataMutex};
+
     std::list<std::string> pathNodes;
-    Node dir = m_nodeManager.FindNode(m_currentDirectory);
+    Node dir = m_nodeManager.FindNode(GetCurrentDirectory());
 
     while (dir.GetUid() != UID_ROOT) {
         pathNodes.emplace_front(dir.GetName());
 
-        auto items = GetDirectoryContents(dir);
+        auto uids = ReadDirectoryUids(dir);
 
-        dir = items.front();
+        dir = m_nodeManager.FindNode(uids.front());
     }
 
     std::string path{"/"};
@@ -46,9 +81,12 @@ std::string Ntfs::Pwd()
 // done
 void Ntfs::Cd(std::string path)
 {
+    // only the working directory of the calling session is written
+    SharedLock lock{m_metadataMutex};
+
     auto parsedPath = ParsePath(std::move(path));
 
-    if (parsedPath.second.back() == "/") {
+    if (!parsedPath.second.empty() && parsedPath.second.back() == "/") {
         parsedPath.second.pop_back();
     }
 
@@ -60,7 +98,7 @@ void Ntfs::Cd(std::string path)
             throw NtfsPathNotFoundException{"directory not found"};
         }
 
-        m_currentDirectory = directory.GetUid();
+        GetCurrentDirectory() = directory.GetUid();
     }
     catch (NtfsNodeNotFoundException &exception) {
         throw NtfsPathNotFoundException{"directory not found"};
@@ -68,8 +106,10 @@ void Ntfs::Cd(std::string path)
 }
 
 // done
-std::list<Node> Ntfs::Ls(std::string path)
+std::list<NodeRef> Ntfs::Ls(std::string path)
 {
+    SharedLock lock{m_metadataMutex};
+
     auto parsedPath = ParsePath(std::move(path));
 
     if (!parsedPath.second.empty() && parsedPath.second.back() == "/") {
@@ -90,12 +130,18 @@ std::list<Node> Ntfs::Ls(std::string path)
 // done
 void Ntfs::Mkdir(std::string path)
 {
+    ExclusiveLock lock{m_metadataMutex};
+
     auto parsedPath = ParsePath(std::move(path));
 
-    if (parsedPath.second.back() == "/") {
+    if (!parsedPath.second.empty() && parsedPath.second.back() == "/") {
         parsedPath.second.pop_back();
     }
 
+    if (parsedPath.second.empty()) {
+        throw NtfsNodeAlreadyExistsException{"the root directory already exists"};
+    }
+
     // take the directory name from path
     std::string directoryName = parsedPath.second.back();
     parsedPath.second.pop_back();
@@ -106,8 +152,8 @@ void Ntfs::Mkdir(std::string path)
         // find the parent directory, where the directory will be created
         Node parent = FindNode(parsedPath.first, parsedPath.second);
 
-        // create node for the directory
-        directory = m_nodeManager.CreateNode(directoryName, true, sizeof(int32_t));
+        // create node for the directory near its parent
+        directory = m_nodeManager.CreateNode(directoryName, true, sizeof(int32_t), parent.GetLastCluster() + 1);
         AddIntoDirectory(parent, directory);
 
         // write parent uid into the directory
@@ -136,12 +182,18 @@ void Ntfs::Mkdir(std::string path)
 // done
 void Ntfs::Rmdir(std::string path)
 {
+    ExclusiveLock lock{m_metadataMutex};
+
     auto parsedPath = ParsePath(std::move(path));
 
-    if (parsedPath.second.back() == "/") {
+    if (!parsedPath.second.empty() && parsedPath.second.back() == "/") {
         parsedPath.second.pop_back();
     }
 
+    if (parsedPath.second.empty()) {
+        throw NtfsFileNotFoundException{"directory not found"};
+    }
+
     // take the directory name from path
     std::string directoryName = parsedPath.second.back();
     parsedPath.second.pop_back();
@@ -172,9 +224,27 @@ void Ntfs::Rmdir(std::string path)
 // done
 void Ntfs::Mkfile(const std::string path, std::istream &contents, int32_t size)
 {
-    auto parsedPath = ParsePath(path);
+    CreateFile(path, size, [this, &contents](const Node &file) {
+        m_nodeManager.WriteIntoNode(file, contents);
+    });
+}
 
-    if (parsedPath.second.back() == "/") {
+// done
+void Ntfs::Mkfile(std::string path, int source, int32_t size)
+{
+    CreateFile(std::move(path), size, [this, source](const Node &file) {
+        m_nodeManager.ImportIntoNode(file, source);
+    });
+}
+
+// done
+void Ntfs::CreateFile(std::string path, int32_t size, const std::function<void(const Node &)> &writeContents)
+{
+    ExclusiveLock lock{m_metadataMutex};
+
+    auto parsedPath = ParsePath(std::move(path));
+
+    if (parsedPath.second.empty() || parsedPath.second.back() == "/") {
         throw NtfsPathNotFoundException{"file not found"};
     }
 
@@ -183,17 +253,18 @@ void Ntfs::Mkfile(const std::string path, std::istream &contents, int32_t size)
     parsedPath.second.pop_back();
 
     Node file;
+    Node parent;
 
     try {
         // find the parent directory, where the file will be created
-        Node parent = FindNode(parsedPath.first, parsedPath.second);
+        parent = FindNode(parsedPath.first, parsedPath.second);
 
-        // create node for the file
-        file = m_nodeManager.CreateNode(fileName, false, size);
+        // create node for the file near its parent
+        file = m_nodeManager.CreateNode(fileName, false, size, parent.GetLastCluster() + 1);
 
         AddIntoDirectory(parent, file);
 
-        m_nodeManager.WriteIntoNode(file, contents);
+        writeContents(file);
     }
     catch (NtfsNodeNotFoundException &exception) {
         throw NtfsPathNotFoundException{"parent directory not found"};
@@ -212,14 +283,22 @@ void Ntfs::Mkfile(const std::string path, std::istream &contents, int32_t size)
         m_nodeManager.ReleaseNode(file);
         throw;
     }
+    catch (PartitionTransferException &exception) {
+        // the contents couldn't be copied
+        RemoveFromDirectory(parent, file);
+        m_nodeManager.ReleaseNode(file);
+        throw;
+    }
 }
 
 // done
 void Ntfs::Rmfile(std::string path)
 {
+    ExclusiveLock lock{m_metadataMutex};
+
     auto parsedPath = ParsePath(std::move(path));
 
-    if (parsedPath.second.back() == "/") {
+    if (parsedPath.second.empty() || parsedPath.second.back() == "/") {
         throw NtfsFileNotFoundException{"file not found"};
     }
 
@@ -240,6 +319,7 @@ void Ntfs::Rmfile(std::string path)
 
         RemoveFromDirectory(parent, file);
         m_nodeManager.ReleaseNode(file);
+        CloseOpenFiles(file);
     }
     catch (NtfsNodeNotFoundException &exception) {
         throw NtfsFileNotFoundException{"file not found"};
@@ -249,15 +329,21 @@ void Ntfs::Rmfile(std::string path)
 // done
 void Ntfs::Mv(std::string sourcePath, std::string destinationPath)
 {
+    ExclusiveLock lock{m_metadataMutex};
+
     auto srcPath = ParsePath(std::move(sourcePath));
 
     bool srcIsDir = false;
 
-    if (srcPath.second.back() == "/") {
+    if (!srcPath.second.empty() && srcPath.second.back() == "/") {
         srcIsDir = true;
         srcPath.second.pop_back();
     }
 
+    if (srcPath.second.empty()) {
+        throw NtfsFileNotFoundException{"source file not found"};
+    }
+
     // take the src name from path
     std::string srcName = srcPath.second.back();
     srcPath.second.pop_back();
@@ -286,13 +372,15 @@ void Ntfs::Mv(std::string sourcePath, std::string destinationPath)
     // take the dest name from path or from the original name
     std::string destName;
 
-    if (destPath.second.back() == "/") {
+    if (destPath.second.empty() || destPath.second.back() == "/") {
         destName = src.GetName();
     }
     else {
         destName = destPath.second.back();
     }
-    destPath.second.pop_back();
+    if (!destPath.second.empty()) {
+        destPath.second.pop_back();
+    }
 
     Node dest;
 
@@ -301,6 +389,7 @@ void Ntfs::Mv(std::string sourcePath, std::string destinationPath)
         dest = FindNode(destPath.first, destPath.second);
 
         m_nodeManager.RenameNode(src, destName);
+        RefreshOpenFiles(src);
 
         if (dest.GetUid() == parent.GetUid()) {
             return;
@@ -315,16 +404,19 @@ void Ntfs::Mv(std::string sourcePath, std::string destinationPath)
     catch (NtfsNotADirectoryException &exception) {
         // dest node is not a directory
         m_nodeManager.RenameNode(src, srcName);
+        RefreshOpenFiles(src);
         throw NtfsPathNotFoundException{"destination directory not found"};
     }
     catch (NodeManagerException &exception) {
         // resources allocation failed
         AddIntoDirectory(parent, src);
         m_nodeManager.RenameNode(src, srcName);
+        RefreshOpenFiles(src);
         throw;
     }
     catch (NtfsNodeAlreadyExistsException &exception) {
         m_nodeManager.RenameNode(src, srcName);
+        RefreshOpenFiles(src);
         throw;
     }
 }
@@ -332,9 +424,11 @@ void Ntfs::Mv(std::string sourcePath, std::string destinationPath)
 //done
 void Ntfs::Cpfile(std::string sourcePath, std::string destinationPath)
 {
+    ExclusiveLock lock{m_metadataMutex};
+
     auto srcPath = ParsePath(std::move(sourcePath));
 
-    if (srcPath.second.back() == "/") {
+    if (srcPath.second.empty() || srcPath.second.back() == "/") {
         throw NtfsFileNotFoundException{"source file not found"};
     }
 
@@ -358,13 +452,15 @@ void Ntfs::Cpfile(std::string sourcePath, std::string destinationPath)
     // take the dest name from path or from the original name
     std::string destName;
 
-    if (destPath.second.back() == "/") {
+    if (destPath.second.empty() || destPath.second.back() == "/") {
         destName = src.GetName();
     }
     else {
         destName = destPath.second.back();
     }
-    destPath.second.pop_back();
+    if (!destPath.second.empty()) {
+        destPath.second.pop_back();
+    }
 
     Node dest;
     Node nodeCopy;
@@ -373,7 +469,7 @@ void Ntfs::Cpfile(std::string sourcePath, std::string destinationPath)
         // find the dest node
         dest = FindNode(destPath.first, destPath.second);
 
-        nodeCopy = m_nodeManager.CloneNode(src, destName);
+        nodeCopy = m_nodeManager.CloneNode(src, destName, dest.GetLastCluster() + 1);
 
         AddIntoDirectory(dest, nodeCopy);
     }
@@ -398,9 +494,11 @@ void Ntfs::Cpfile(std::string sourcePath, std::string destinationPath)
 // done
 void Ntfs::Cat(std::string path, std::ostream &output)
 {
+    SharedLock lock{m_metadataMutex};
+
     auto parsedPath = ParsePath(std::move(path));
 
-    if (parsedPath.second.back() == "/") {
+    if (parsedPath.second.empty() || parsedPath.second.back() == "/") {
         throw NtfsFileNotFoundException{"file not found"};
     }
 
@@ -412,6 +510,7 @@ void Ntfs::Cat(std::string path, std::ostream &output)
             throw NtfsFileNotFoundException{"file not found"};
         }
 
+        SharedLock nodeLock{GetNodeMutex(file.GetUid())};
         m_nodeManager.ReadFromNode(file, output);
     }
     catch (NtfsNodeNotFoundException &exception) {
@@ -419,20 +518,293 @@ void Ntfs::Cat(std::string path, std::ostream &output)
     }
 }
 
+// done
+void Ntfs::Cat(std::string path, int destination)
+{
+    SharedLock lock{m_metadataMutex};
+    Node file = FindFile(std::move(path));
+
+    SharedLock nodeLock{GetNodeMutex(file.GetUid())};
+    m_nodeManager.ExportFromNode(file, destination);
+}
+
+// done
+int32_t Ntfs::Read(std::string path, int32_t offset, int32_t length, std::ostream &output)
+{
+    SharedLock lock{m_metadataMutex};
+    Node file = FindFile(std::move(path));
+
+    SharedLock nodeLock{GetNodeMutex(file.GetUid())};
+
+    return ReadData(file, offset, length, output);
+}
+
+// done
+int32_t Ntfs::ReadTail(std::string path, int32_t length, std::ostream &output)
+{
+    SharedLock lock{m_metadataMutex};
+    Node file = FindFile(std::move(path));
+
+    SharedLock nodeLock{GetNodeMutex(file.GetUid())};
+
+    // the size can't change while the metadata lock is held
+    int32_t offset = std::max(file.GetSize() - length, 0);
+
+    return ReadData(file, offset, length, output);
+}
+
+// done
+void Ntfs::Write(std::string path, int32_t offset, std::istream &data, int32_t length)
+{
+    {
+        SharedLock lock{m_metadataMutex};
+        Node file = FindFile(path);
+
+        if (static_cast<int64_t>(offset) + length <= file.GetSize()) {
+            // the file isn't resized, so only its data are overwritten
+            ExclusiveLock nodeLock{GetNodeMutex(file.GetUid())};
+            WriteData(file, ExtentMap{file}, offset, data, length);
+            return;
+        }
+    }
+
+    ExclusiveLock lock{m_metadataMutex};
+    Node file = FindFile(std::move(path));
+    ExtentMap extents{file};
+
+    WriteIntoFile(file, extents, offset, data, length);
+    RefreshOpenFiles(file);
+}
+
+// done
+void Ntfs::Append(std::string path, std::istream &data, int32_t length)
+{
+    ExclusiveLock lock{m_metadataMutex};
+    Node file = FindFile(std::move(path));
+    ExtentMap extents{file};
+
+    WriteIntoFile(file, extents, file.GetSize(), data, length);
+    RefreshOpenFiles(file);
+}
+
+// done
+void Ntfs::Truncate(std::string path, int32_t size)
+{
+    ExclusiveLock lock{m_metadataMutex};
+    Node file = FindFile(std::move(path));
+    int32_t originalSize = file.GetSize();
+
+    m_nodeManager.ResizeNode(file, size);
+
+    if (size > originalSize) {
+        WriteZeros(file, ExtentMap{file}, originalSize, size);
+    }
+
+    RefreshOpenFiles(file);
+}
+
+// done
+int32_t Ntfs::Open(std::string path)
+{
+    SharedLock lock{m_metadataMutex};
+    Node file = FindFile(std::move(path));
+    ExtentMap extents{file};
+
+    std::lock_guard<std::mutex> filesLock{m_openFilesMutex};
+    int32_t session = GetSession();
+    int32_t descriptor = m_nextDescriptors[session]++;
+    m_openFiles.emplace(std::make_pair(session, descriptor), OpenFile{std::move(file), std::move(extents), 0});
+
+    return descriptor;
+}
+
+// done
+int32_t Ntfs::Read(int32_t descriptor, int32_t length, std::ostream &output)
+{
+    SharedLock lock{m_metadataMutex};
+    OpenFile openFile = CopyOpenFile(descriptor);
+
+    SharedLock nodeLock{GetNodeMutex(openFile.node.GetUid())};
+
+    // read the data through a bounded buffer
+    std::vector<char> buffer;
+    buffer.resize(static_cast<size_t>(std::min(length, COPY_BUFFER_CLUSTERS * m_partition.GetClusterSize())));
+
+    int32_t totalRead{0};
+
+    while (totalRead < length) {
+        int32_t toRead = std::min(length - totalRead, static_cast<int32_t>(buffer.size()));
+        int32_t read = m_nodeManager.ReadFromNode(
+            openFile.node, openFile.extents, openFile.position, toRead, buffer.data());
+
+        if (read == 0) {
+            break;
+        }
+
+        output.write(buffer.data(), read);
+
+        totalRead += read;
+        openFile.position += read;
+    }
+
+    UpdatePosition(descriptor, openFile.position);
+
+    return totalRead;
+}
+
+// done
+void Ntfs::Write(int32_t descriptor, std::istream &data, int32_t length)
+{
+    {
+        SharedLock lock{m_metadataMutex};
+        OpenFile openFile = CopyOpenFile(descriptor);
+
+        if (static_cast<int64_t>(openFile.position) + length <= openFile.node.GetSize()) {
+            // the file isn't resized, so only its data are overwritten
+            ExclusiveLock nodeLock{GetNodeMutex(openFile.node.GetUid())};
+            WriteData(openFile.node, openFile.extents, openFile.position, data, length);
+            UpdatePosition(descriptor, openFile.position + length);
+            return;
+        }
+    }
+
+    ExclusiveLock lock{m_metadataMutex};
+    OpenFile openFile = CopyOpenFile(descriptor);
+
+    WriteIntoFile(openFile.node, openFile.extents, openFile.position, data, length);
+    UpdatePosition(descriptor, openFile.position + length);
+
+    // the file was resized, all its open files are outdated
+    RefreshOpenFiles(openFile.node);
+}
+
+// done
+void Ntfs::Seek(int32_t descriptor, int32_t position)
+{
+    if (position < 0) {
+        throw NtfsException{"negative file position"};
+    }
+
+    std::lock_guard<std::mutex> lock{m_openFilesMutex};
+    GetOpenFile(descriptor).position = position;
+}
+
+// done
+void Ntfs::Close(int32_t descriptor)
+{
+    std::lock_guard<std::mutex> lock{m_openFilesMutex};
+    GetOpenFile(descriptor);
+
+    m_openFiles.erase(std::make_pair(GetSession(), descriptor));
+}
+
+// done
+int32_t Ntfs::Defragment(std::string path, const DefragmentProgress &progress)
+{
+    ExclusiveLock lock{m_metadataMutex};
+    Node node = FindPathNode(std::move(path));
+    size_t fragmentCount = node.GetExtentCount();
+
+    if (fragmentCount <= 1) {
+        // nothing to defragment
+        return 0;
+    }
+
+    if (!m_nodeManager.RelocateNode(node)) {
+        return 0;
+    }
+
+    RefreshOpenFiles(node);
+
+    progress(node, fragmentCount);
+
+    return node.GetClusterCount();
+}
+
+// done
+int32_t Ntfs::Defragment(int32_t clusterBudget, const DefragmentProgress &progress)
+{
+    ExclusiveLock lock{m_metadataMutex};
+    auto nodes = m_nodeManager.GetAllNodes();
+
+    // process the nodes in order of their position on the partition
+    std::sort(nodes.begin(), nodes.end(), [](const Node &node1, const Node &node2) {
+        return node1.GetMftItems().front().item.fragments[0].start < node2.GetMftItems().front().item.fragments[0].start;
+    });
+
+    auto bitmap = m_partition.ReadBitmap();
+    int32_t movedClusters{0};
+
+    for (auto &node : nodes) {
+        size_t fragmentCount = node.GetExtentCount();
+        auto clusterCount = node.GetClusterCount();
+
+        if (movedClusters >= clusterBudget) {
+            // the budget is exhausted
+            break;
+        }
+
+        // only the nodes which really move are charged, a node over the rest of the budget is skipped
+        if (!m_nodeManager.CompactNode(node, bitmap, clusterBudget - movedClusters)) {
+            continue;
+        }
+
+        RefreshOpenFiles(node);
+
+        movedClusters += clusterCount;
+        progress(node, fragmentCount);
+    }
+
+    return movedClusters;
+}
+
 //done
-void Ntfs::Format(int32_t size, std::string signature, std::string description)
+void Ntfs::Format(int32_t size, std::string signature, std::string description,
+                  const std::function<void()> &stopBackground)
 {
+    ExclusiveLock lock{m_metadataMutex};
+
+    // no other client can start the background work between its stop and the format
+    stopBackground();
+
     m_partition.Format(size, std::move(signature), std::move(description));
+
+    std::lock_guard<std::mutex> filesLock{m_openFilesMutex};
+    m_openFiles.clear();
 }
 
 // done
 Node Ntfs::FindNode(std::string path)
+{
+    SharedLock lock{m_metadataMutex};
+
+    return FindPathNode(std::move(path));
+}
+
+// done
+int32_t Ntfs::CreateSession()
+{
+    return m_nextSession++;
+}
+
+// done
+void Ntfs::CloseSession(int32_t session)
+{
+    std::lock_guard<std::mutex> lock{m_openFilesMutex};
+
+    m_openFiles.erase(m_openFiles.lower_bound(std::make_pair(session, INT32_MIN)),
+                      m_openFiles.lower_bound(std::make_pair(session + 1, INT32_MIN)));
+    m_nextDescriptors.erase(session);
+}
+
+// done
+Node Ntfs::FindPathNode(std::string path)
 {
     auto parsedPath = ParsePath(std::move(path));
 
     bool nodeIsDir = false;
 
-    if (parsedPath.second.back() == "/") {
+    if (!parsedPath.second.empty() && parsedPath.second.back() == "/") {
         nodeIsDir = true;
         parsedPath.second.pop_back();
     }
@@ -447,7 +819,197 @@ Node Ntfs::FindNode(std::string path)
 }
 
 // done
-std::list<Node> Ntfs::GetDirectoryContents(const Node &directory)
+Node Ntfs::FindFile(std::string path)
+{
+    auto parsedPath = ParsePath(std::move(path));
+
+    if (parsedPath.second.empty() || parsedPath.second.back() == "/") {
+        throw NtfsFileNotFoundException{"file not found"};
+    }
+
+    try {
+        Node file = FindNode(parsedPath.first, parsedPath.second);
+
+        if (file.IsDirectory()) {
+            throw NtfsFileNotFoundException{"file not found"};
+        }
+
+        return file;
+    }
+    catch (NtfsNodeNotFoundException &exception) {
+        throw NtfsFileNotFoundException{"file not found"};
+    }
+}
+
+// done
+Ntfs::OpenFile &Ntfs::GetOpenFile(int32_t descriptor)
+{
+    auto found = m_openFiles.find(std::make_pair(GetSession(), descriptor));
+
+    if (found == m_openFiles.end()) {
+        throw NtfsBadDescriptorException{"the descriptor " + std::to_string(descriptor) + " is not open"};
+    }
+
+    return found->second;
+}
+
+// done
+Ntfs::OpenFile Ntfs::CopyOpenFile(int32_t descriptor)
+{
+    std::lock_guard<std::mutex> lock{m_openFilesMutex};
+
+    return GetOpenFile(descriptor);
+}
+
+// done
+void Ntfs::UpdatePosition(int32_t descriptor, int32_t position)
+{
+    std::lock_guard<std::mutex> lock{m_openFilesMutex};
+    auto found = m_openFiles.find(std::make_pair(GetSession(), descriptor));
+
+    if (found != m_openFiles.end()) {
+        found->second.position = position;
+    }
+}
+
+// done
+int32_t Ntfs::GetSession() const
+{
+    return sessionId;
+}
+
+// done
+int32_t &Ntfs::GetCurrentDirectory()
+{
+    return sessionDirectory != nullptr ? *sessionDirectory : m_currentDirectory;
+}
+
+// done
+std::shared_timed_mutex &Ntfs::GetNodeMutex(int32_t uid)
+{
+    return m_nodeMutexes[static_cast<uint32_t>(uid) % m_nodeMutexes.size()];
+}
+
+// done
+void Ntfs::RefreshOpenFiles(const Node &node)
+{
+    std::lock_guard<std::mutex> lock{m_openFilesMutex};
+
+    for (auto &entry : m_openFiles) {
+        OpenFile &openFile = entry.second;
+
+        if (openFile.node.GetUid() == node.GetUid()) {
+            openFile.node = node;
+            openFile.extents = ExtentMap{node};
+        }
+    }
+}
+
+// done
+void Ntfs::CloseOpenFiles(const Node &node)
+{
+    std::lock_guard<std::mutex> lock{m_openFilesMutex};
+
+    for (auto itFile = m_openFiles.begin(); itFile != m_openFiles.end();) {
+        if (itFile->second.node.GetUid() == node.GetUid()) {
+            itFile = m_openFiles.erase(itFile);
+        } else {
+            itFile++;
+        }
+    }
+}
+
+// done
+void Ntfs::WriteIntoFile(Node &file, ExtentMap &extents, int32_t offset, std::istream &data, int32_t length)
+{
+    if (static_cast<int64_t>(offset) + length > INT32_MAX) {
+        throw NtfsException{"the file would be too big"};
+    }
+
+    int32_t originalSize = file.GetSize();
+
+    if (offset + length > originalSize) {
+        m_nodeManager.ResizeNode(file, offset + length);
+        extents = ExtentMap{file};
+    }
+
+    if (offset > originalSize) {
+        // fill the gap behind the original end
+        WriteZeros(file, extents, originalSize, offset);
+    }
+
+    WriteData(file, extents, offset, data, length);
+}
+
+// done
+void Ntfs::WriteData(const Node &file, const ExtentMap &extents, int32_t offset, std::istream &data, int32_t length)
+{
+    // write the data through a bounded buffer
+    std::vector<char> buffer;
+    buffer.resize(static_cast<size_t>(std::min(length, COPY_BUFFER_CLUSTERS * m_partition.GetClusterSize())));
+
+    for (int32_t written = 0; written < length;) {
+        int32_t toWrite = std::min(length - written, static_cast<int32_t>(buffer.size()));
+
+        data.read(buffer.data(), toWrite);
+        auto read = static_cast<int32_t>(data.gcount());
+
+        if (read > 0) {
+            m_nodeManager.WriteIntoNode(file, extents, offset + written, read, buffer.data());
+            written += read;
+        }
+
+        if (read < toWrite) {
+            // never leave the stale cluster contents in the written range
+            WriteZeros(file, extents, offset + written, offset + length);
+
+            throw NtfsDataTooShortException{
+                "the data end after " + std::to_string(written) + " of " + std::to_string(length) + " bytes"};
+        }
+    }
+}
+
+// done
+int32_t Ntfs::ReadData(const Node &file, int32_t offset, int32_t length, std::ostream &output)
+{
+    ExtentMap extents{file};
+
+    // read the data through a bounded buffer
+    std::vector<char> buffer;
+    buffer.resize(static_cast<size_t>(std::min(length, COPY_BUFFER_CLUSTERS * m_partition.GetClusterSize())));
+
+    int32_t totalRead{0};
+
+    while (totalRead < length) {
+        int32_t toRead = std::min(length - totalRead, static_cast<int32_t>(buffer.size()));
+        int32_t read = m_nodeManager.ReadFromNode(file, extents, offset + totalRead, toRead, buffer.data());
+
+        if (read == 0) {
+            break;
+        }
+
+        output.write(buffer.data(), read);
+        totalRead += read;
+    }
+
+    return totalRead;
+}
+
+// done
+void Ntfs::WriteZeros(const Node &file, const ExtentMap &extents, int32_t from, int32_t to)
+{
+    std::vector<char> zeros;
+    zeros.resize(static_cast<size_t>(std::min(to - from, COPY_BUFFER_CLUSTERS * m_partition.GetClusterSize())));
+
+    for (int32_t position = from; position < to;) {
+        int32_t toWrite = std::min(to - position, static_cast<int32_t>(zeros.size()));
+
+        position += m_nodeManager.WriteIntoNode(file, extents, position, toWrite, zeros.data());
+    }
+}
+
+// done
+std::vector<int32_t> Ntfs::ReadDirectoryUids(const Node &directory)
 {
     if (!directory.IsDirectory()) {
         throw NtfsNotADirectoryException("the given node is not a directory - can't do dir manipulations");
@@ -458,13 +1020,15 @@ std::list<Node> Ntfs::GetDirectoryContents(const Node &directory)
 
     m_nodeManager.ReadFromNode(directory, uids.data());
 
-    std::list<Node> items;
+    return uids;
+}
 
-    for (auto &uid : uids) {
-        items.emplace_back(m_nodeManager.FindNode(uid));
-    }
+// done
+std::list<NodeRef> Ntfs::GetDirectoryContents(const Node &directory)
+{
+    auto refs = m_nodeManager.FindNodes(ReadDirectoryUids(directory));
 
-    return items;
+    return std::list<NodeRef>{refs.begin(), refs.end()};
 }
 
 // done
@@ -486,7 +1050,10 @@ void Ntfs::AddIntoDirectory(Node &directory, const Node &node)
         }
     }
 
-    items.emplace_back(node);
+    m_partition.GetDirtyMap().MarkDirectory(directory.GetUid());
+    m_partition.GetDirtyMap().MarkRelinked(node.GetUid());
+
+    items.emplace_back(m_partition, node);
     std::vector<int32_t> uids;
     uids.reserve(items.size());
 
@@ -505,21 +1072,20 @@ void Ntfs::AddIntoDirectory(Node &directory, const Node &node)
 // done
 void Ntfs::RemoveFromDirectory(Node &directory, const Node &node)
 {
-    auto items = GetDirectoryContents(directory);
-
-    for (auto itItem = items.begin(); itItem != items.end(); itItem++) {
-        if (itItem->GetUid() == node.GetUid()) {
-            // item found
+    if (node.GetMftItems().empty()) {
+        // the node wasn't created, so it can't be in the directory
+        return;
+    }
 
-            items.erase(itItem);
+    auto uids = ReadDirectoryUids(directory);
 
-            std::vector<int32_t> uids;
-            uids.reserve(items.size());
+    for (auto itUid = uids.begin(); itUid != uids.end(); itUid++) {
+        if (*itUid == node.GetUid()) {
+            // item found
+            m_partition.GetDirtyMap().MarkDirectory(directory.GetUid());
+            m_partition.GetDirtyMap().MarkRelinked(node.GetUid());
 
-            // fill uids into the vector
-            for (auto &item : items) {
-                uids.emplace_back(item.GetUid());
-            }
+            uids.erase(itUid);
 
             // resize directory node to its contents
             auto newSize = static_cast<int32_t>(uids.size() * sizeof(int32_t));
@@ -538,17 +1104,17 @@ std::pair<int32_t, std::list<std::string>> Ntfs::ParsePath(std::string path)
     std::list<std::string> pathNodes;
     int32_t start;
 
-    if (path.front() == '/') {
+    if (!path.empty() && path.front() == '/') {
         start = UID_ROOT;
         path.erase(0, 1);
     }
     else {
-        start = m_currentDirectory;
+        start = GetCurrentDirectory();
     }
 
     bool endSlash = false;
 
-    if (path.back() == '/') {
+    if (!path.empty() && path.back() == '/') {
         endSlash = true;
         path.pop_back();
     }
@@ -579,7 +1145,7 @@ Node Ntfs::FindNode(int32_t directory, const std::list<std::string> &path)
 
         bool notFound = true;
 
-        std::list<Node> items;
+        std::list<NodeRef> items;
 
         try {
             items = GetDirectoryContents(currentNode);
@@ -589,7 +1155,7 @@ Node Ntfs::FindNode(int32_t directory, const std::list<std::string> &path)
         }
 
         if (pathNode == "..") {
-            currentNode = std::move(items.front());
+            currentNode = m_nodeManager.FindNode(items.front());
             continue;
         }
 
@@ -598,7 +1164,7 @@ Node Ntfs::FindNode(int32_t directory, const std::list<std::string> &path)
 
         for (auto &item : items) {
             if (item.GetName() == pathNode) {
-                currentNode = std::move(item);
+                currentNode = m_nodeManager.FindNode(item);
                 notFound = false;
                 break;
             }
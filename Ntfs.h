@@ -2,23 +2,83 @@
 
 #include <memory>
 #include <list>
+#include <map>
+#include <atomic>
+#include <array>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
 
 #include "Partition.h"
 #include "Node.h"
 #include "NodeManager.h"
+#include "ExtentMap.h"
 
+/**
+ * The class Ntfs is the file system facade, its operations may be called from multiple threads.
+ * The lookups and the reads of the node data run concurrently, the changes of the metadata
+ * are serialized and the writes into the node data are serialized per node.
+ */
 class Ntfs
 {
     friend class NtfsChecker;
     friend class NodeSizeChecker;
     friend class DirectoryTreeChecker;
+    friend class ConsistencyChecker;
+    friend class Scrubber;
 public:
+    /**
+     * The typedef for the defragmentation progress handler.
+     * It is called with every relocated node and its original number of fragments.
+     */
+    typedef std::function<void(const Node &node, size_t fragmentCount)> DefragmentProgress;
+
+    /**
+     * The scope of a session with its own current working directory and its own open files.
+     * While the scope lives, the calls from the thread which created it resolve
+     * the relative paths from the session directory and the cd changes it,
+     * the descriptors are looked up only among the files opened in the session.
+     * The scopes nest, the previous session of the thread is restored at the scope end.
+     */
+    class SessionScope
+    {
+    public:
+        /**
+         * Bind the session to the calling thread.
+         *
+         * @param session The session id given by CreateSession.
+         * @param currentDirectory The uid of the session working directory, it must outlive the scope.
+         */
+        SessionScope(int32_t session, int32_t &currentDirectory);
+
+        /**
+         * Restore the previous session of the thread.
+         */
+        ~SessionScope();
+
+        SessionScope(const SessionScope &) = delete;
+
+        SessionScope &operator=(const SessionScope &) = delete;
+
+    private:
+        /**
+         * The session bound before this scope.
+         */
+        int32_t m_previousSession;
+
+        /**
+         * The session directory bound before this scope.
+         */
+        int32_t *m_previousDirectory;
+    };
+
     /**
      * Initializes a ntfs bound to the partition file on the given path.
      *
      * @param partitionPath The partition file path.
+     * @param threadPool The thread pool for the parallel work.
      */
-    explicit Ntfs(std::string partitionPath);
+    Ntfs(std::string partitionPath, ThreadPool &threadPool);
 
     /**
      * Check whether the partition is opened.
@@ -49,9 +109,9 @@ public:
      *
      * @throws NtfsPathNotFoundException When the directory is not found.
      *
-     * @return The list of directory child nodes.
+     * @return The list of handles of the directory child nodes.
      */
-    std::list<Node> Ls(std::string path = ".");
+    std::list<NodeRef> Ls(std::string path = ".");
 
     /**
      * Create a directory on the given path.
@@ -85,6 +145,20 @@ public:
      */
     void Mkfile(std::string path, std::istream &contents, int32_t size);
 
+    /**
+     * Create a new file with the contents read from the file descriptor.
+     * The contents are copied inside the kernel if possible.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     * @param source The file descriptor of the contents, read from its current offset.
+     * @param size The size of the file contents.
+     *
+     * @throws NtfsPathNotFoundException When the destination directory is not found.
+     * @throws NtfsNodeAlreadyExistsException When the node of the given path already exists.
+     * @throws PartitionTransferException When the contents can't be copied.
+     */
+    void Mkfile(std::string path, int source, int32_t size);
+
     /**
      * Remove the file.
      *
@@ -128,16 +202,185 @@ public:
      */
     void Cat(std::string path, std::ostream &output);
 
+    /**
+     * Copy file contents into the file descriptor.
+     * The contents are copied inside the kernel if possible.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     * @param destination The destination file descriptor, written at its current offset.
+     *
+     * @throws NtfsFileNotFoundException When the file is not found.
+     * @throws PartitionTransferException When the contents can't be copied.
+     */
+    void Cat(std::string path, int destination);
+
+    /**
+     * Write the data into the file on the given offset.
+     * The file grows in place if the data reach behind its end,
+     * the gap between its original end and the offset is filled with zeros.
+     * Only the clusters holding the written part are written.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     * @param offset The offset in bytes from the start of the file.
+     * @param data The stream of data to be written.
+     * @param length The number of bytes to be written.
+     *
+     * @throws NtfsFileNotFoundException When the file is not found.
+     * @throws NtfsDataTooShortException When the data stream ends before the length, the rest is zeroed.
+     */
+    void Write(std::string path, int32_t offset, std::istream &data, int32_t length);
+
+    /**
+     * Append the data on the end of the file.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     * @param data The stream of data to be appended.
+     * @param length The number of bytes to be appended.
+     *
+     * @throws NtfsFileNotFoundException When the file is not found.
+     * @throws NtfsDataTooShortException When the data stream ends before the length, the rest is zeroed.
+     */
+    void Append(std::string path, std::istream &data, int32_t length);
+
+    /**
+     * Change the size of the file.
+     * The file is shrunk or grown in place, the grown part is filled with zeros.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     * @param size The new size of the file.
+     *
+     * @throws NtfsFileNotFoundException When the file is not found.
+     */
+    void Truncate(std::string path, int32_t size);
+
+    /**
+     * Open the file and return its descriptor.
+     * The open file keeps its node, its extent map and the current position,
+     * so the reads and writes through the descriptor don't look up the path
+     * nor read the mft.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     *
+     * @throws NtfsFileNotFoundException When the file is not found.
+     *
+     * @return The file descriptor.
+     */
+    int32_t Open(std::string path);
+
+    /**
+     * Read the data from the current position of the open file
+     * into the output stream and move the position behind them.
+     *
+     * @param descriptor The file descriptor.
+     * @param length The max number of bytes to be read.
+     * @param output The output stream.
+     *
+     * @throws NtfsBadDescriptorException When the descriptor doesn't belong to an open file.
+     *
+     * @return The number of bytes read.
+     */
+    int32_t Read(int32_t descriptor, int32_t length, std::ostream &output);
+
+    /**
+     * Write the data on the current position of the open file
+     * and move the position behind them.
+     *
+     * @param descriptor The file descriptor.
+     * @param data The stream of data to be written.
+     * @param length The number of bytes to be written.
+     *
+     * @throws NtfsBadDescriptorException When the descriptor doesn't belong to an open file.
+     * @throws NtfsDataTooShortException When the data stream ends before the length, the rest is zeroed.
+     */
+    void Write(int32_t descriptor, std::istream &data, int32_t length);
+
+    /**
+     * Set the current position of the open file.
+     * The position can be set behind the end of the file.
+     *
+     * @param descriptor The file descriptor.
+     * @param position The new position in bytes from the start of the file.
+     *
+     * @throws NtfsBadDescriptorException When the descriptor doesn't belong to an open file.
+     */
+    void Seek(int32_t descriptor, int32_t position);
+
+    /**
+     * Close the open file.
+     *
+     * @param descriptor The file descriptor.
+     *
+     * @throws NtfsBadDescriptorException When the descriptor doesn't belong to an open file.
+     */
+    void Close(int32_t descriptor);
+
+    /**
+     * Relocate the node clusters into one undivided run of free clusters.
+     *
+     * @param path The node path - absolute or relative to the current working directory.
+     * @param progress The handler called when the node is relocated.
+     *
+     * @throws NtfsNodeNotFoundException When the node is not found.
+     *
+     * @return The number of moved clusters.
+     */
+    int32_t Defragment(std::string path, const DefragmentProgress &progress);
+
+    /**
+     * Compact the whole data segment.
+     * Goes through the nodes in order of their position on the partition and moves
+     * every fragmented node or a node, which fits into a free run before it,
+     * into the first sufficient free run. A node, which would exceed the rest of the budget, is skipped.
+     *
+     * @param clusterBudget The max number of clusters to be moved.
+     * @param progress The handler called with every relocated node.
+     *
+     * @return The number of moved clusters.
+     */
+    int32_t Defragment(int32_t clusterBudget, const DefragmentProgress &progress);
+
+    /**
+     * Print the part of the file contents into the output stream.
+     * Only the clusters holding the requested part are read.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     * @param offset The offset of the data in bytes from the start of the file.
+     * @param length The max number of bytes to be read.
+     * @param output The output stream.
+     *
+     * @throws NtfsFileNotFoundException When the file is not found.
+     *
+     * @return The number of bytes read.
+     */
+    int32_t Read(std::string path, int32_t offset, int32_t length, std::ostream &output);
+
+    /**
+     * Print the end of the file contents into the output stream.
+     * The file and its size are resolved once, so the read part is the end of the same file.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     * @param length The max number of bytes to be read from the end of the file.
+     * @param output The output stream.
+     *
+     * @throws NtfsFileNotFoundException When the file is not found.
+     *
+     * @return The number of bytes read.
+     */
+    int32_t ReadTail(std::string path, int32_t length, std::ostream &output);
+
     /**
      * Format the partition.
      *
      * @param size The new size of the partition.
      * @param signature The signature of the partition.
      * @param description The partition description.
+     * @param stopBackground The handler stopping the background work on the partition,
+     *                       it is called under the exclusive metadata lock before the partition is recreated.
      *
      * @throws PartitionFileNotOpenedException If it fails to open the partition file.
      */
-    void Format(int32_t size, std::string signature, std::string description);
+    void Format(int32_t size, std::string signature, std::string description,
+                const std::function<void()> &stopBackground);
 
     /**
     * Find the node.
@@ -150,32 +393,207 @@ public:
     */
     Node FindNode(std::string path);
 
+    /**
+     * Create a new session, its open files are kept apart from the files of the other sessions.
+     *
+     * @return The session id.
+     */
+    int32_t CreateSession();
+
+    /**
+     * Close all the files opened in the session.
+     *
+     * @param session The session id.
+     */
+    void CloseSession(int32_t session);
+
 private:
     /**
      * The ntfs partition which this ntfs operates on.
      */
     Partition m_partition;
 
+    /**
+     * The thread pool for the parallel work.
+     */
+    ThreadPool &m_threadPool;
+
     /**
      * The node manager instance bound to the same ntfs partition.
      */
     NodeManager m_nodeManager;
 
     /**
-     * The uid of the current working directory.
+     * The uid of the current working directory used outside the sessions.
      */
     int32_t m_currentDirectory;
 
+    /**
+     * Get the current working directory of the session bound to the calling thread.
+     *
+     * @return The uid of the session directory or of the ntfs current directory outside the sessions.
+     */
+    int32_t &GetCurrentDirectory();
+
+    /**
+     * The structure of an open file.
+     */
+    struct OpenFile
+    {
+        Node node;                                      // the file node
+        ExtentMap extents;                              // the extent map of the file
+        int32_t position;                               // the current position in the file
+    };
+
+    /**
+     * The open files by their sessions and descriptors.
+     */
+    std::map<std::pair<int32_t, int32_t>, OpenFile> m_openFiles;
+
+    /**
+     * The descriptor of the next open file by the sessions.
+     */
+    std::map<int32_t, int32_t> m_nextDescriptors;
+
+    /**
+     * The id of the next session.
+     */
+    std::atomic<int32_t> m_nextSession{SESSION_DEFAULT + 1};
+
+    /**
+     * Get the session bound to the calling thread.
+     *
+     * @return The session id or SESSION_DEFAULT outside the sessions.
+     */
+    int32_t GetSession() const;
+
+    /**
+     * The typedef for the shared lock of the metadata or of the node data.
+     */
+    typedef std::shared_lock<std::shared_timed_mutex> SharedLock;
+
+    /**
+     * The typedef for the exclusive lock of the metadata or of the node data.
+     */
+    typedef std::unique_lock<std::shared_timed_mutex> ExclusiveLock;
+
+    /**
+     * The lock of the metadata - the mft, the bitmap, the directories and the current directory.
+     * The lookups and the data accesses hold it shared, the metadata changes hold it exclusively.
+     * It is always taken before the node data lock and the open files lock.
+     */
+    std::shared_timed_mutex m_metadataMutex;
+
+    /**
+     * The striped locks of the node data, taken by the node uid under the shared metadata lock.
+     * The data readers hold it shared, the writers overwriting the data in place hold it exclusively.
+     */
+    std::array<std::shared_timed_mutex, NODE_LOCK_STRIPES> m_nodeMutexes;
+
+    /**
+     * The lock of the open files and the next descriptors, it is never held while accessing the partition.
+     */
+    std::mutex m_openFilesMutex;
+
+    /**
+     * Get the lock of the node data.
+     *
+     * @param uid The node uid.
+     *
+     * @return The node data lock shared with the other nodes on the same stripe.
+     */
+    std::shared_timed_mutex &GetNodeMutex(int32_t uid);
+
+    /**
+     * Get the open file of the session bound to the calling thread.
+     *
+     * @param descriptor The file descriptor.
+     *
+     * @throws NtfsBadDescriptorException When the descriptor doesn't belong to a file open in the session.
+     *
+     * @return The open file.
+     */
+    OpenFile &GetOpenFile(int32_t descriptor);
+
+    /**
+     * Get a copy of the open file, so it can be used without holding the open files lock.
+     *
+     * @param descriptor The file descriptor.
+     *
+     * @throws NtfsBadDescriptorException When the descriptor doesn't belong to a file open in the session.
+     *
+     * @return The copy of the open file.
+     */
+    OpenFile CopyOpenFile(int32_t descriptor);
+
+    /**
+     * Set the position of the open file, unless it was closed meanwhile.
+     *
+     * @param descriptor The file descriptor.
+     * @param position The new position in the file.
+     */
+    void UpdatePosition(int32_t descriptor, int32_t position);
+
+    /**
+     * Find the node on the given path, the lookup of the public FindNode without locking.
+     *
+     * @param path The node path.
+     *
+     * @throws NtfsNodeNotFoundException When the node is not found.
+     *
+     * @return The found node.
+     */
+    Node FindPathNode(std::string path);
+
+    /**
+     * Update the node and the extent map of every open file
+     * which is the given node.
+     *
+     * @param node The changed node.
+     */
+    void RefreshOpenFiles(const Node &node);
+
+    /**
+     * Close every open file which is the given node.
+     *
+     * @param node The removed node.
+     */
+    void CloseOpenFiles(const Node &node);
+
+    /**
+     * Create a new file and fill its contents.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     * @param size The size of the file contents.
+     * @param writeContents The function writing the contents into the created file node.
+     *
+     * @throws NtfsPathNotFoundException When the destination directory is not found.
+     * @throws NtfsNodeAlreadyExistsException When the node of the given path already exists.
+     */
+    void CreateFile(std::string path, int32_t size, const std::function<void(const Node &)> &writeContents);
+
+    /**
+     * Read the uids of the directory child nodes.
+     *
+     * @param directory The directory to be read.
+     *
+     * @throws NtfsNotADirectoryException When the given directory node is not a directory.
+     *
+     * @return The vector of uids, the first one is the uid of the parent directory.
+     */
+    std::vector<int32_t> ReadDirectoryUids(const Node &directory);
+
     /**
      * Get the directory contents.
+     * The child nodes are looked up in one pass over the mft.
      *
      * @param directory The directory to be listed.
      *
      * @throws NtfsNotADirectoryException When the given directory node is not a directory.
      *
-     * @return The list of the directory child nodes.
+     * @return The list of handles of the directory child nodes, the first one is the parent directory.
      */
-    std::list<Node> GetDirectoryContents(const Node &directory);
+    std::list<NodeRef> GetDirectoryContents(const Node &directory);
 
     /**
      * Add the node into the directory.
@@ -198,6 +616,66 @@ private:
      */
     void RemoveFromDirectory(Node &directory, const Node &node);
 
+    /**
+     * Find the file on the given path.
+     *
+     * @param path The file path - absolute or relative to the current working directory.
+     *
+     * @throws NtfsFileNotFoundException When the file is not found or the node is a directory.
+     *
+     * @return The found file node.
+     */
+    Node FindFile(std::string path);
+
+    /**
+     * Write the data into the file on the given offset and grow it eventually.
+     *
+     * @param file The file node.
+     * @param extents The extent map of the file, it is rebuilt if the file grows.
+     * @param offset The offset in bytes from the start of the file.
+     * @param data The stream of data to be written.
+     * @param length The number of bytes to be written.
+     *
+     * @throws NtfsDataTooShortException When the data stream ends before the length, the rest is zeroed.
+     */
+    void WriteIntoFile(Node &file, ExtentMap &extents, int32_t offset, std::istream &data, int32_t length);
+
+    /**
+     * Overwrite the data of the file in place, the written range must lie within the file size.
+     *
+     * @param file The file node.
+     * @param extents The extent map of the file.
+     * @param offset The offset in bytes from the start of the file.
+     * @param data The stream of data to be written.
+     * @param length The number of bytes to be written.
+     *
+     * @throws NtfsDataTooShortException When the data stream ends before the length, the rest is zeroed.
+     */
+    void WriteData(const Node &file, const ExtentMap &extents, int32_t offset, std::istream &data, int32_t length);
+
+    /**
+     * Print the part of the file contents into the output stream through a bounded buffer.
+     * The caller must hold the metadata lock and the node lock.
+     *
+     * @param file The file node.
+     * @param offset The offset of the data in bytes from the start of the file.
+     * @param length The max number of bytes to be read.
+     * @param output The output stream.
+     *
+     * @return The number of bytes read.
+     */
+    int32_t ReadData(const Node &file, int32_t offset, int32_t length, std::ostream &output);
+
+    /**
+     * Fill the part of the file contents with zeros.
+     *
+     * @param file The file node.
+     * @param extents The extent map of the file.
+     * @param from The offset of the first byte to be zeroed.
+     * @param to The offset behind the last byte to be zeroed.
+     */
+    void WriteZeros(const Node &file, const ExtentMap &extents, int32_t from, int32_t to);
+
     /**
      * Parse the path into the individual path nodes
      * and a starting directory.
@@ -1,10 +1,13 @@
 #include <limits>
 #include <cmath>
+#include <algorithm>
+#include <unordered_map>
 #include "NtfsChecker.h"
 #include "Text.h"
 #include "Exceptions/PartitionExceptions.h"
 #include "NodeSizeChecker.h"
 #include "DirectoryTreeChecker.h"
+#include "ConsistencyChecker.h"
 
 // done
 NtfsChecker::NtfsChecker(Ntfs &ntfs)
@@ -14,6 +17,7 @@ NtfsChecker::NtfsChecker(Ntfs &ntfs)
 // done
 void NtfsChecker::PrintBootRecord(std::ostream &output)
 {
+    Ntfs::SharedLock lock{m_ntfs.m_metadataMutex};
     Partition &partition = m_ntfs.m_partition;
 
     if (!partition.IsOpened()) {
@@ -37,6 +41,7 @@ void NtfsChecker::PrintBootRecord(std::ostream &output)
 // done
 void NtfsChecker::PrintMft(std::ostream &output, bool printAll)
 {
+    Ntfs::SharedLock lock{m_ntfs.m_metadataMutex};
     Partition &partition = m_ntfs.m_partition;
 
     if (!partition.IsOpened()) {
@@ -80,6 +85,7 @@ void NtfsChecker::PrintMft(std::ostream &output, bool printAll)
 // done
 void NtfsChecker::PrintBitmap(std::ostream &output)
 {
+    Ntfs::SharedLock lock{m_ntfs.m_metadataMutex};
     Partition &partition = m_ntfs.m_partition;
 
     if (!partition.IsOpened()) {
@@ -106,21 +112,153 @@ void NtfsChecker::PrintBitmap(std::ostream &output)
     output << Text::hline(61) << std::endl;
 }
 
+// done
+void NtfsChecker::PrintFragmentationStats(std::ostream &output, size_t topCount)
+{
+    Ntfs::SharedLock lock{m_ntfs.m_metadataMutex};
+    Partition &partition = m_ntfs.m_partition;
+
+    if (!partition.IsOpened()) {
+        throw PartitionFileNotOpenedException{"partition file is not opened"};
+    }
+
+    struct NodeStats
+    {
+        int32_t uid;
+        std::string name;
+        int32_t fragments;
+    };
+
+    // ---- one pass over the mft ----
+
+    std::unordered_map<int32_t, NodeStats> nodes;
+    int32_t mftItemCount = partition.GetMftItemCount();
+    int32_t usedMftItems{0};
+
+    for (int32_t start = 0; start < mftItemCount; start += MFT_READ_CHUNK_SIZE) {
+        auto chunk = partition.ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
+
+        for (auto &mftItem : chunk) {
+            mft_item &item = mftItem.item;
+
+            if (item.uid == UID_ITEM_FREE) {
+                continue;
+            }
+
+            usedMftItems++;
+
+            auto &stats = nodes[item.uid];
+            stats.uid = item.uid;
+            stats.name = item.name;
+
+            for (int i = 0; i < MFT_FRAGMENTS_COUNT && item.fragments[i].start != FRAGMENT_UNUSED_START; i++) {
+                stats.fragments++;
+            }
+        }
+    }
+
+    // ---- one pass over the bitmap ----
+
+    auto bitmap = partition.ReadBitmap();
+    auto extents = m_ntfs.m_nodeManager.FindFreeExtents(bitmap);
+
+    int32_t freeClusters{0};
+    int32_t largestFreeRun{0};
+    std::vector<int32_t> extentBuckets;
+
+    for (auto &extent : extents) {
+        freeClusters += extent.count;
+        largestFreeRun = std::max(largestFreeRun, extent.count);
+
+        auto bucket = static_cast<size_t>(std::log2(extent.count));
+        extentBuckets.resize(std::max(extentBuckets.size(), bucket + 1));
+        extentBuckets[bucket]++;
+    }
+
+    std::vector<int32_t> fragmentBuckets;
+    std::vector<NodeStats> sortedNodes;
+    int32_t fragmentedNodes{0};
+
+    sortedNodes.reserve(nodes.size());
+
+    for (auto &entry : nodes) {
+        auto &stats = entry.second;
+
+        if (stats.fragments > 1) {
+            fragmentedNodes++;
+        }
+
+        auto bucket = static_cast<size_t>(std::log2(std::max(stats.fragments, 1)));
+        fragmentBuckets.resize(std::max(fragmentBuckets.size(), bucket + 1));
+        fragmentBuckets[bucket]++;
+
+        sortedNodes.emplace_back(stats);
+    }
+
+    topCount = std::min(topCount, sortedNodes.size());
+
+    std::partial_sort(sortedNodes.begin(), sortedNodes.begin() + topCount, sortedNodes.end(),
+                      [](const NodeStats &node1, const NodeStats &node2) {
+                          return node1.fragments > node2.fragments;
+                      });
+
+    // ---- print the report ----
+
+    output << Text::hline(61) << std::endl;
+    output << "      Mft items used: " << usedMftItems << " / " << mftItemCount << std::endl;
+    output << "               Nodes: " << nodes.size() << std::endl;
+    output << "    Fragmented nodes: " << fragmentedNodes << std::endl;
+    output << "       Free clusters: " << freeClusters << " / " << partition.GetClusterCount() << std::endl;
+    output << "        Free extents: " << extents.size() << std::endl;
+    output << "    Largest free run: " << largestFreeRun << std::endl;
+    output << Text::hline(61) << std::endl;
+
+    output << "Fragments per node:" << std::endl;
+    PrintHistogram(output, fragmentBuckets);
+    output << Text::hline(61) << std::endl;
+
+    output << "Free extent sizes (clusters):" << std::endl;
+    PrintHistogram(output, extentBuckets);
+    output << Text::hline(61) << std::endl;
+
+    output << "Most fragmented nodes:" << std::endl;
+    output
+        << Text::justifyR("uid", 10) << "|"
+        << Text::justifyR("name", 12) << "|"
+        << Text::justifyR("fragments", 10) << std::endl;
+
+    for (size_t i = 0; i < topCount; i++) {
+        output
+            << Text::justifyR(std::to_string(sortedNodes[i].uid), 10) << "|"
+            << Text::justifyR(sortedNodes[i].name, 12) << "|"
+            << Text::justifyR(std::to_string(sortedNodes[i].fragments), 10) << std::endl;
+    }
+
+    output << Text::hline(61) << std::endl;
+}
+
+// done
+void NtfsChecker::PrintHistogram(std::ostream &output, const std::vector<int32_t> &buckets)
+{
+    for (size_t i = 0; i < buckets.size(); i++) {
+        int64_t from = int64_t{1} << i;
+        int64_t to = (int64_t{1} << (i + 1)) - 1;
+
+        std::string range = from == to ? std::to_string(from) : std::to_string(from) + "-" + std::to_string(to);
+
+        output << Text::justifyR(range, 21) << ": " << buckets[i] << std::endl;
+    }
+}
+
 // done
 bool NtfsChecker::CheckBootRecord(std::ostream &output)
 {
+    Ntfs::SharedLock lock{m_ntfs.m_metadataMutex};
     boot_record bootRecord = m_ntfs.m_partition.GetBootRecord();
 
     // ---- check partition size ----
 
-    auto &file = m_ntfs.m_partition.m_file;
-
-    // compute the partition file size
-    file.seekg(0, std::ios::beg);
-    file.ignore(std::numeric_limits<std::streamsize>::max());
-    std::streamsize size = file.gcount();
-    file.clear();
-    file.seekg(0, std::ios_base::beg);
+    off_t size = m_ntfs.m_partition.GetFileSize();
 
     if (size != bootRecord.partition_size) {
         output <<
@@ -165,22 +303,71 @@ bool NtfsChecker::CheckBootRecord(std::ostream &output)
 // done
 bool NtfsChecker::CheckNodeSizes(std::ostream &output)
 {
+    Ntfs::SharedLock lock{m_ntfs.m_metadataMutex};
     NodeSizeChecker checker{m_ntfs, output};
 
-    return checker.Run(4);
+    return checker.Run();
 }
 
 // done
 bool NtfsChecker::CheckFileDirectories(std::ostream &output)
 {
+    Ntfs::SharedLock lock{m_ntfs.m_metadataMutex};
     DirectoryTreeChecker checker{m_ntfs, output};
 
     return checker.Run();
 }
 
+// done
+bool NtfsChecker::CheckConsistency(std::ostream &output)
+{
+    Ntfs::ExclusiveLock lock{m_ntfs.m_metadataMutex};
+    ConsistencyChecker checker{m_ntfs, output};
+
+    if (!checker.Run()) {
+        return false;
+    }
+
+    m_ntfs.m_partition.GetDirtyMap().Clear();
+    return true;
+}
+
+// done
+bool NtfsChecker::CheckIncremental(std::ostream &output)
+{
+    Ntfs::ExclusiveLock lock{m_ntfs.m_metadataMutex};
+    ConsistencyChecker checker{m_ntfs, output};
+
+    if (!checker.RunIncremental()) {
+        return false;
+    }
+
+    m_ntfs.m_partition.GetDirtyMap().Clear();
+    return true;
+}
+
+// done
+bool NtfsChecker::RepairConsistency(std::ostream &output)
+{
+    Ntfs::ExclusiveLock lock{m_ntfs.m_metadataMutex};
+    ConsistencyChecker checker{m_ntfs, output};
+
+    if (!checker.Run()) {
+        checker.Repair();
+
+        if (!checker.Run()) {
+            return false;
+        }
+    }
+
+    m_ntfs.m_partition.GetDirtyMap().Clear();
+    return true;
+}
+
 // done
 void NtfsChecker::AddInconsistency()
 {
+    Ntfs::ExclusiveLock lock{m_ntfs.m_metadataMutex};
     Node node1 = m_ntfs.m_nodeManager.CreateNode("outdir", false, 200);
 
     Node node2 = m_ntfs.m_nodeManager.CreateNode("sizediff", false, 3000);
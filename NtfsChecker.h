@@ -37,6 +37,17 @@ public:
      */
     void PrintBitmap(std::ostream &output);
 
+    /**
+     * Print the fragmentation and space usage report to the given output stream.
+     * Reads the mft and the bitmap only once and prints the node fragment count
+     * distribution, the free extent size histogram, the largest free run,
+     * the mft occupancy and the most fragmented nodes.
+     *
+     * @param output The output stream.
+     * @param topCount The number of the most fragmented nodes to be printed.
+     */
+    void PrintFragmentationStats(std::ostream &output, size_t topCount);
+
     /**
      * Check the boot record values.
      * Checks the partition size against the actual size,
@@ -70,6 +81,39 @@ public:
      */
     bool CheckFileDirectories(std::ostream &output);
 
+    /**
+     * Run the full consistency check, which reads the mft and the bitmap only once
+     * and cross-validates the clusters owned by the nodes with the bitmap,
+     * the node sizes and the directory tree.
+     * The partition dirty map is cleared when the check succeeds.
+     *
+     * @param output The output to print messages.
+     *
+     * @return True if everything is OK, false otherwise.
+     */
+    bool CheckConsistency(std::ostream &output);
+
+    /**
+     * Run the incremental consistency check of the changes since the last successful check.
+     * The partition dirty map is cleared when the check succeeds.
+     *
+     * @param output The output to print messages.
+     *
+     * @return True if everything is OK, false otherwise.
+     */
+    bool CheckIncremental(std::ostream &output);
+
+    /**
+     * Run the full consistency check and repair the found problems,
+     * then run the check again to verify the repair.
+     * The partition dirty map is cleared when the partition is consistent.
+     *
+     * @param output The output to print messages.
+     *
+     * @return True if the partition is consistent after the repair, false otherwise.
+     */
+    bool RepairConsistency(std::ostream &output);
+
     /**
      * Add a file that isn't in any directory and a file
      * that has different number of clusters than it needs.
@@ -82,6 +126,14 @@ private:
      * The ntfs which the ntfs checker operates on.
      */
     Ntfs &m_ntfs;
+
+    /**
+     * Print the histogram with the power of two buckets.
+     *
+     * @param output The output stream.
+     * @param buckets The bucket counts, the bucket i holds the values from 2^i to 2^(i+1)-1.
+     */
+    void PrintHistogram(std::ostream &output, const std::vector<int32_t> &buckets);
 };
 
 
@@ -5,12 +5,30 @@
 
 const std::size_t NODE_NAME_SIZE{12};                   // the size of the node name field (including the termination symbol)
 const int32_t MFT_FRAGMENTS_COUNT{32};                  // the max number of fragments per one mft item
+const int32_t MFT_ITEMS_PER_NODE_MAX{INT8_MAX};         // the max number of mft items per one node (limited by mft_item::count)
 const int32_t FRAGMENT_UNUSED_START{-1};        // the max number of fragments per one mft item
 const int32_t UID_ITEM_FREE{0};                         // the uid of a free mft item
 const int32_t UID_ROOT{1};                              // the uid of the root directory
+const int32_t SESSION_DEFAULT{0};                       // the session of the calls made outside the session scopes
+const int32_t MFT_INDEX_UNKNOWN{-1};                    // the mft item index of a node not looked up yet
 const bool BIT_CLUSTER_FREE{false};                     // the boolean value of bit in a bitmap representing a free cluster
 const double MFT_SIZE_RELATIVE_TO_PARTITION_SIZE{0.1};  // the ratio of size, that takes the mft relative to the total partition size
 const int32_t CLUSTER_SIZE{1024};                       // the size of one cluster in bytes
+const int32_t SCRUB_GROUP_SIZE{8192};                   // the number of clusters the scrubber checks under one lock
+const int32_t MFT_READ_CHUNK_SIZE{256};                 // the number of mft items read from the partition at once
+const int32_t COPY_BUFFER_CLUSTERS{64};                 // the number of clusters copied within the partition at once
+const std::size_t IMPORT_BUFFER_SIZE{1 << 20};          // the size of one buffer of the import pipeline in bytes
+const std::size_t IMPORT_BUFFER_COUNT{4};               // the number of buffers of the import pipeline
+const int64_t SCRUB_DEFAULT_RATE{1 << 22};              // the default max number of bytes read by the scrubber per second
+const int SCRUB_NICENESS{19};                           // the nice value of the scrubber thread
+const int SCRUB_LOCK_POLL_MS{10};                       // the period of checking the stop while waiting for the metadata lock
+const std::size_t NODE_LOCK_STRIPES{64};                // the number of locks guarding the node data
+const int SERVER_BACKLOG{64};                           // the max number of pending connections of the server socket
+const std::size_t SERVER_READ_SIZE{4096};               // the number of bytes read from a client at once
+const std::size_t SERVER_MAX_LINE_LENGTH{1 << 20};      // the max length of a command line sent by a client
+const std::size_t BATCH_READ_SIZE{1 << 16};             // the number of bytes of the batch requests read at once
+const std::size_t BATCH_WRITE_BUFFER_SIZE{1 << 16};     // the size of the buffer of the batch responses
+const int JSON_MAX_DEPTH{64};                           // the max nesting of the json values in a batch request
 
 /**
  * The representation of ntfs boot record as it lays in memory
@@ -2,46 +2,49 @@
 #include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 
 #include "Partition.h"
 #include "Exceptions/PartitionExceptions.h"
 
 Partition::Partition(std::string path)
-    : m_path(std::move(path))
+    : m_path(std::move(path)),
+      m_dirtyMap(m_path)
 {
-    // try to open file for reading
-    // it does not overwrite existing file and does not create a new file if it not exists
-    m_file.open(m_path, std::ios::in);
-
-
-    if (!m_file.is_open()) {
-        // file does not exist, partition is not formatted
-
-        m_file.close();
+    // the partition is not formatted if the file doesn't exist yet
+    if (access(m_path.c_str(), F_OK) != 0) {
         return;
     }
 
     // open file for reading and writing
-    m_file.close();
-    m_file.open(m_path, std::ios::in | std::ios::out | std::ios::binary);
-
-    if (!m_file.is_open()) {
-        throw PartitionFileNotOpenedException{"can not open file " + m_path};
-    }
+    OpenDescriptor(O_RDWR);
 
     // try to read boot record
-    m_file.read(reinterpret_cast<char *>(&m_bootRecord), sizeof(m_bootRecord));
-
-    if (m_file.eof()) {
+    try {
+        ReadShared(0, &m_bootRecord, sizeof(m_bootRecord));
+    }
+    catch (PartitionReadException &) {
         // cant read boot record
-        m_file.close();
+        CloseDescriptor();
         throw PartitionCorruptedException{"can't read the partitions boot record"};
     }
 
     if (!ValidateBootRecord(m_bootRecord)) {
-        m_file.close();
+        CloseDescriptor();
         throw PartitionCorruptedException{"the partitions boot record contains invalid data"};
     }
+
+    m_dirtyMap.Load();
+}
+
+// done
+Partition::~Partition()
+{
+    CloseDescriptor();
 }
 
 void Partition::Format(int32_t size, std::string signature, std::string description)
@@ -64,11 +67,8 @@ void Partition::Format(int32_t size, std::string signature, std::string descript
             "max description length is " + std::to_string(sizeof(boot_record::description) - 1));
     }
 
-    // close previously opened partition file
-    m_file.close();
-
     // open partition file and clear its contents
-    m_file.open(m_path, std::ios::binary | std::ios::trunc | std::ios::in | std::ios::out);
+    OpenDescriptor(O_RDWR | O_CREAT | O_TRUNC);
 
     // init partition info
     int32_t mftItemCount = ComputeMftItemCount(size);
@@ -95,30 +95,22 @@ void Partition::Format(int32_t size, std::string signature, std::string descript
     m_bootRecord.data_start_address = sizeof(boot_record) + mftSize + bitmapSize;
     m_bootRecord.mft_max_fragment_count = MFT_FRAGMENTS_COUNT;
 
+    // the bitmap and the data segment are zeroed by the file extension
+    if (ftruncate(m_fd, m_bootRecord.partition_size) != 0) {
+        CloseDescriptor();
+        throw PartitionFileNotOpenedException{"can't resize file " + m_path + ": " + std::strerror(errno)};
+    }
+
     // write boot record
-    m_file.write(reinterpret_cast<const char *>(&m_bootRecord), sizeof(boot_record));
+    WriteShared(0, &m_bootRecord, sizeof(boot_record));
 
     // write mft
-    for (int i = 0; i < mftItemCount; ++i) {
-        mft_item mftItem{};
+    std::vector<mft_item> mftItems(static_cast<size_t>(mftItemCount));
+    for (auto &mftItem : mftItems) {
         mftItem.uid = UID_ITEM_FREE;
-
-        m_file.write(reinterpret_cast<const char *>(&mftItem), sizeof(mft_item));
-    }
-
-    // write bitmap
-    for (int j = 0; j < bitmapSize; ++j) {
-        uint8_t byte{0};
-        m_file.write(reinterpret_cast<const char *>(&byte), sizeof(byte));
-    }
-
-    // write clusters
-    for (int k = 0; k < clusterCount; ++k) {
-        uint8_t cluster[CLUSTER_SIZE];
-        m_file.write(reinterpret_cast<const char *>(&cluster), CLUSTER_SIZE);
     }
 
-    m_file.flush();
+    WriteShared(m_bootRecord.mft_start_address, mftItems.data(), mftItems.size() * sizeof(mft_item));
 
     // create root directory
     int32_t uid = UID_ROOT;
@@ -146,6 +138,9 @@ void Partition::Format(int32_t size, std::string signature, std::string descript
     WriteMftItem(rootMftItem);
     WriteBitmapBit(0, true);
     WriteCluster(0, &uid, sizeof(int32_t));
+
+    // the new partition is consistent
+    m_dirtyMap.Clear();
 }
 
 // done
@@ -165,15 +160,111 @@ MftItem Partition::ReadMftItem(int32_t index)
 }
 
 // done
-std::vector<MftItem> Partition::ReadMftItems(int32_t uid)
+std::vector<MftItem> Partition::ReadMftRange(int32_t start, int32_t count)
+{
+    if (start < 0 || count < 0 || start + count > GetMftItemCount()) {
+        throw PartitionMftOutOfBoundsException{
+            "mft item range " + std::to_string(start) + "+" + std::to_string(count) + " is out of bounds"};
+    }
+
+    std::vector<mft_item> buffer;
+    buffer.resize(static_cast<size_t>(count));
+
+    if (count > 0) {
+        int32_t address = GetMftStartAddress() + start * sizeof(mft_item);
+        Read(address, buffer.data(), buffer.size() * sizeof(mft_item));
+    }
+
+    std::vector<MftItem> items;
+    items.reserve(buffer.size());
+
+    for (int32_t i = 0; i < count; i++) {
+        items.push_back(MftItem{start + i, buffer[i]});
+    }
+
+    return items;
+}
+
+// done
+std::vector<MftItem> Partition::ReadMftRangeShared(int32_t start, int32_t count) const
 {
+    if (start < 0 || count < 0 || start + count > GetMftItemCount()) {
+        throw PartitionMftOutOfBoundsException{
+            "mft item range " + std::to_string(start) + "+" + std::to_string(count) + " is out of bounds"};
+    }
+
+    std::vector<mft_item> buffer;
+    buffer.resize(static_cast<size_t>(count));
+
+    ReadShared(GetMftStartAddress() + static_cast<off_t>(start) * sizeof(mft_item),
+               buffer.data(),
+               buffer.size() * sizeof(mft_item));
+
     std::vector<MftItem> items;
+    items.reserve(buffer.size());
+
+    for (int32_t i = 0; i < count; i++) {
+        items.push_back(MftItem{start + i, buffer[i]});
+    }
+
+    return items;
+}
+
+// done
+std::vector<bool> Partition::ReadBitmapRangeShared(int32_t start, int32_t count) const
+{
+    if (start < 0 || count < 0 || start > GetClusterCount() - count) {
+        throw PartitionBitmapOutOfBoundsException{
+            "bitmap range " + std::to_string(start) + "+" + std::to_string(count) + " is out of bounds"};
+    }
+
+    std::vector<bool> bits;
+    bits.resize(static_cast<size_t>(count));
+
+    if (count == 0) {
+        return bits;
+    }
+
+    int32_t firstByte = start / 8;
+    int32_t lastByte = (start + count - 1) / 8;
+
+    std::vector<uint8_t> bytes;
+    bytes.resize(static_cast<size_t>(lastByte - firstByte + 1));
+
+    ReadShared(GetBitmapStartAddress() + firstByte, bytes.data(), bytes.size());
+
+    for (int32_t i = 0; i < count; i++) {
+        int32_t index = start + i;
+        bits[i] = static_cast<bool>(bytes[index / 8 - firstByte] & (1 << (index % 8)));
+    }
+
+    return bits;
+}
 
-    for (int i = 0; i < GetMftItemCount(); i++) {
-        MftItem item = ReadMftItem(i);
+// done
+void Partition::ReadClusterRunShared(int32_t index, void *destination, size_t dataSize) const
+{
+    ReadShared(GetClusterRunAddress(index, dataSize), destination, dataSize);
+}
 
-        if (item.item.uid == uid) {
-            items.emplace_back(item);
+// done
+std::vector<MftItem> Partition::ReadMftItems(int32_t uid, bool wholeMft)
+{
+    std::vector<MftItem> items;
+    int32_t mftItemCount = GetMftItemCount();
+
+    for (int32_t start = 0; start < mftItemCount; start += MFT_READ_CHUNK_SIZE) {
+        auto chunk = ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
+
+        for (auto &item : chunk) {
+            if (item.item.uid == uid) {
+                items.emplace_back(item);
+            }
+        }
+
+        if (!wholeMft && !items.empty() && items.size() >= items.front().item.count) {
+            // all the node mft items found
+            break;
         }
     }
 
@@ -184,6 +275,24 @@ std::vector<MftItem> Partition::ReadMftItems(int32_t uid)
     return items;
 }
 
+// done
+int32_t Partition::FindMftItem(int32_t uid)
+{
+    int32_t mftItemCount = GetMftItemCount();
+
+    for (int32_t start = 0; start < mftItemCount; start += MFT_READ_CHUNK_SIZE) {
+        auto chunk = ReadMftRange(start, std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start));
+
+        for (auto &item : chunk) {
+            if (item.item.uid == uid && item.item.order == 0) {
+                return item.index;
+            }
+        }
+    }
+
+    return MFT_INDEX_UNKNOWN;
+}
+
 // done
 void Partition::WriteMftItem(const MftItem &item)
 {
@@ -193,14 +302,41 @@ void Partition::WriteMftItem(const MftItem &item)
 
     int32_t address = GetMftStartAddress() + item.index * sizeof(mft_item);
 
+    m_dirtyMap.MarkMftItem(item.index);
     Write(address, &item.item, sizeof(mft_item));
 }
 
 // done
 void Partition::WriteMftItems(const std::vector<MftItem> &items)
 {
-    for (auto &item : items) {
-        WriteMftItem(item);
+    std::vector<MftItem> sorted{items};
+
+    std::sort(sorted.begin(), sorted.end(), [](const MftItem &item1, const MftItem &item2) {
+        return item1.index < item2.index;
+    });
+
+    std::vector<mft_item> buffer;
+
+    for (size_t i = 0; i < sorted.size(); i++) {
+        buffer.push_back(sorted[i].item);
+
+        if (i + 1 < sorted.size() && sorted[i + 1].index == sorted[i].index + 1) {
+            // the next item continues the run
+            continue;
+        }
+
+        auto first = static_cast<int32_t>(sorted[i].index - buffer.size() + 1);
+
+        if (first < 0 || sorted[i].index >= GetMftItemCount()) {
+            throw PartitionMftOutOfBoundsException{"mft item index " + std::to_string(sorted[i].index) + " is out of bounds"};
+        }
+
+        for (int32_t index = first; index <= sorted[i].index; index++) {
+            m_dirtyMap.MarkMftItem(index);
+        }
+
+        Write(GetMftStartAddress() + first * sizeof(mft_item), buffer.data(), buffer.size() * sizeof(mft_item));
+        buffer.clear();
     }
 }
 
@@ -220,6 +356,26 @@ bool Partition::ReadBitmapBit(int32_t index)
     return static_cast<bool>(byte & (1 << bitOffset));
 }
 
+// done
+std::vector<bool> Partition::ReadBitmap()
+{
+    int32_t clusterCount = GetClusterCount();
+
+    std::vector<uint8_t> bytes;
+    bytes.resize(static_cast<size_t>(GetDataStartAddress() - GetBitmapStartAddress()));
+
+    Read(GetBitmapStartAddress(), bytes.data(), bytes.size());
+
+    std::vector<bool> bitmap;
+    bitmap.resize(static_cast<size_t>(clusterCount));
+
+    for (int32_t index = 0; index < clusterCount; index++) {
+        bitmap[index] = static_cast<bool>(bytes[index / 8] & (1 << (index % 8)));
+    }
+
+    return bitmap;
+}
+
 // done
 void Partition::WriteBitmapBit(int32_t index, bool bit)
 {
@@ -242,6 +398,82 @@ void Partition::WriteBitmapBit(int32_t index, bool bit)
     Write(GetBitmapStartAddress() + byteIndex, &byte, sizeof(uint8_t));
 }
 
+// done
+void Partition::WriteBitmapRun(int32_t start, int32_t count, bool bit)
+{
+    if (start < 0 || count < 0 || start + count > GetClusterCount()) {
+        throw PartitionBitmapOutOfBoundsException{
+            "bitmap run " + std::to_string(start) + "+" + std::to_string(count) + " is out of bounds"};
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    int32_t firstByte = start / 8;
+    int32_t lastByte = (start + count - 1) / 8;
+
+    std::vector<uint8_t> bytes;
+    bytes.resize(static_cast<size_t>(lastByte - firstByte + 1));
+
+    Read(GetBitmapStartAddress() + firstByte, bytes.data(), bytes.size());
+
+    for (int32_t index = start; index < start + count; index++) {
+        uint8_t &byte = bytes[index / 8 - firstByte];
+
+        if (bit) {
+            byte |= (1 << (index % 8));
+        } else {
+            byte &= ~(1 << (index % 8));
+        }
+    }
+
+    Write(GetBitmapStartAddress() + firstByte, bytes.data(), bytes.size());
+}
+
+// done
+void Partition::CopyClusters(int32_t source, int32_t destination, int32_t count)
+{
+    if (source < 0 || count < 0 || source + count > GetClusterCount()) {
+        throw PartitionDataOutOfBoundsException{"source cluster run is out of bounds"};
+    }
+
+    if (destination < 0 || destination + count > GetClusterCount()) {
+        throw PartitionDataOutOfBoundsException{"destination cluster run is out of bounds"};
+    }
+
+    int32_t clusterSize = GetClusterSize();
+    off_t sourcePosition = GetDataStartAddress() + static_cast<off_t>(source) * clusterSize;
+    off_t destinationPosition = GetDataStartAddress() + static_cast<off_t>(destination) * clusterSize;
+    auto remaining = static_cast<size_t>(count) * clusterSize;
+
+    // try to copy the data inside the partition file by the kernel first
+    while (remaining > 0) {
+        ssize_t copied = copy_file_range(m_fd, &sourcePosition, m_fd, &destinationPosition, remaining, 0);
+
+        if (copied <= 0) {
+            break;
+        }
+
+        remaining -= copied;
+    }
+
+    // copy the rest through the buffer
+    std::vector<char> buffer;
+    buffer.resize(std::min(remaining, static_cast<size_t>(COPY_BUFFER_CLUSTERS * clusterSize)));
+
+    while (remaining > 0) {
+        size_t toCopy = std::min(remaining, buffer.size());
+
+        ReadShared(sourcePosition, buffer.data(), toCopy);
+        WriteShared(destinationPosition, buffer.data(), toCopy);
+
+        sourcePosition += toCopy;
+        destinationPosition += toCopy;
+        remaining -= toCopy;
+    }
+}
+
 // done
 void Partition::ReadCluster(int32_t index, void *destination, size_t dataSize)
 {
@@ -258,6 +490,70 @@ void Partition::ReadCluster(int32_t index, void *destination, size_t dataSize)
     Read(address, destination, dataSize);
 }
 
+// done
+void Partition::ReadClusterRun(int32_t index, int32_t offset, void *destination, size_t dataSize)
+{
+    int64_t start = static_cast<int64_t>(index) * GetClusterSize() + offset;
+
+    if (index < 0 || offset < 0 || start + dataSize > static_cast<int64_t>(GetClusterCount()) * GetClusterSize()) {
+        throw PartitionDataOutOfBoundsException{"cluster run " + std::to_string(index) + " is out of bounds"};
+    }
+
+    Read(static_cast<int32_t>(GetDataStartAddress() + start), destination, dataSize);
+}
+
+// done
+void Partition::ExportClusterRun(int32_t index, size_t dataSize, int destination)
+{
+    off_t position = GetClusterRunAddress(index, dataSize);
+
+    // try to copy the data inside the kernel first
+    while (dataSize > 0) {
+        ssize_t copied = copy_file_range(m_fd, &position, destination, nullptr, dataSize, 0);
+
+        if (copied <= 0) {
+            break;
+        }
+
+        dataSize -= copied;
+    }
+
+    while (dataSize > 0) {
+        ssize_t copied = sendfile(destination, m_fd, &position, dataSize);
+
+        if (copied <= 0) {
+            break;
+        }
+
+        dataSize -= copied;
+    }
+
+    // copy the rest through the buffer
+    std::vector<char> buffer;
+    buffer.resize(std::min(dataSize, static_cast<size_t>(COPY_BUFFER_CLUSTERS * GetClusterSize())));
+
+    while (dataSize > 0) {
+        ssize_t read = pread(m_fd, buffer.data(), std::min(dataSize, buffer.size()), position);
+
+        if (read <= 0) {
+            throw PartitionTransferException{"can't read the partition: " + std::string{std::strerror(errno)}};
+        }
+
+        for (ssize_t written = 0; written < read;) {
+            ssize_t count = write(destination, buffer.data() + written, static_cast<size_t>(read - written));
+
+            if (count < 0) {
+                throw PartitionTransferException{"can't write the data: " + std::string{std::strerror(errno)}};
+            }
+
+            written += count;
+        }
+
+        position += read;
+        dataSize -= read;
+    }
+}
+
 // done
 void Partition::ReadClusters(const std::vector<int32_t> &indexes, void *destination, size_t dataSize)
 {
@@ -322,6 +618,42 @@ void Partition::WriteCluster(int32_t index, const void *source, size_t dataSize)
     Write(address, source, dataSize);
 }
 
+// done
+void Partition::WriteClusterRun(int32_t index, int32_t offset, const void *source, size_t dataSize)
+{
+    int64_t start = static_cast<int64_t>(index) * GetClusterSize() + offset;
+
+    if (index < 0 || offset < 0 || start + dataSize > static_cast<int64_t>(GetClusterCount()) * GetClusterSize()) {
+        throw PartitionDataOutOfBoundsException{"cluster run " + std::to_string(index) + " is out of bounds"};
+    }
+
+    Write(static_cast<int32_t>(GetDataStartAddress() + start), source, dataSize);
+}
+
+// done
+size_t Partition::ImportClusterRun(int32_t index, size_t dataSize, int source)
+{
+    off_t position = GetClusterRunAddress(index, dataSize);
+    size_t remaining = dataSize;
+
+    while (remaining > 0) {
+        ssize_t copied = copy_file_range(source, nullptr, m_fd, &position, remaining, 0);
+
+        if (copied < 0) {
+            break;
+        }
+
+        if (copied == 0) {
+            throw PartitionTransferException{"the source data ended unexpectedly"};
+        }
+
+        remaining -= copied;
+    }
+
+    // the rest is left to the positional writes of the caller, the partition file offset is never used
+    return dataSize - remaining;
+}
+
 // done
 void Partition::WriteClusters(const std::vector<int32_t> &indexes, const void *source, size_t dataSize)
 {
@@ -373,7 +705,7 @@ void Partition::WriteClusters(const std::vector<int32_t> &indexes, std::istream
 // done
 bool Partition::IsOpened() const
 {
-    return m_file.is_open();
+    return m_fd >= 0;
 }
 
 // done
@@ -486,6 +818,24 @@ int32_t Partition::GetPartitionSize() const
     return m_bootRecord.partition_size;
 }
 
+// done
+off_t Partition::GetFileSize() const
+{
+    struct stat status{};
+
+    if (m_fd < 0 || fstat(m_fd, &status) != 0) {
+        throw PartitionFileNotOpenedException{"can't get the size of file " + m_path};
+    }
+
+    return status.st_size;
+}
+
+// done
+DirtyMap &Partition::GetDirtyMap()
+{
+    return m_dirtyMap;
+}
+
 // done
 void Partition::Read(int32_t position, void *destination, size_t size)
 {
@@ -497,9 +847,7 @@ void Partition::Read(int32_t position, void *destination, size_t size)
         throw PartitionOutOfBoundsException{"trying to read outside of the partition"};
     }
 
-    m_file.flush();
-    m_file.seekg(position);
-    m_file.read(static_cast<char *>(destination), size);
+    ReadShared(position, destination, size);
 }
 
 // done
@@ -513,9 +861,100 @@ void Partition::Write(int32_t position, const void *source, size_t size)
         throw PartitionOutOfBoundsException{"trying to write outside of the partition"};
     }
 
-    m_file.seekp(position);
-    m_file.write(static_cast<const char *>(source), size);
-    m_file.flush();
+    WriteShared(position, source, size);
+}
+
+// done
+void Partition::ReadShared(off_t position, void *destination, size_t size) const
+{
+    if (m_fd < 0) {
+        throw PartitionFileNotOpenedException{"partition file is not opened, probably not formatted"};
+    }
+
+    auto buffer = static_cast<char *>(destination);
+
+    while (size > 0) {
+        ssize_t read = pread(m_fd, buffer, size, position);
+
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (read <= 0) {
+            throw PartitionReadException{
+                "can't read the partition at " + std::to_string(position) + ": "
+                    + (read < 0 ? std::strerror(errno) : "unexpected end of file")};
+        }
+
+        buffer += read;
+        position += read;
+        size -= static_cast<size_t>(read);
+    }
+}
+
+// done
+void Partition::WriteShared(off_t position, const void *source, size_t size)
+{
+    if (m_fd < 0) {
+        throw PartitionFileNotOpenedException{"partition file is not opened, probably not formatted"};
+    }
+
+    auto buffer = static_cast<const char *>(source);
+
+    while (size > 0) {
+        ssize_t written = pwrite(m_fd, buffer, size, position);
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (written <= 0) {
+            throw PartitionTransferException{
+                "can't write the partition at " + std::to_string(position) + ": "
+                    + (written < 0 ? std::strerror(errno) : "nothing written")};
+        }
+
+        buffer += written;
+        position += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+// done
+void Partition::OpenDescriptor(int flags)
+{
+    CloseDescriptor();
+
+    m_fd = open(m_path.c_str(), flags, 0644);
+
+    if (m_fd < 0) {
+        throw PartitionFileNotOpenedException{"can not open file " + m_path};
+    }
+}
+
+// done
+void Partition::CloseDescriptor()
+{
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+// done
+off_t Partition::GetClusterRunAddress(int32_t index, size_t dataSize) const
+{
+    if (!IsOpened()) {
+        throw PartitionFileNotOpenedException{"partition file is not opened, probably not formatted"};
+    }
+
+    int64_t start = static_cast<int64_t>(index) * GetClusterSize();
+
+    if (index < 0 || start + dataSize > static_cast<int64_t>(GetClusterCount()) * GetClusterSize()) {
+        throw PartitionDataOutOfBoundsException{"cluster run " + std::to_string(index) + " is out of bounds"};
+    }
+
+    return GetDataStartAddress() + start;
 }
 
 // done
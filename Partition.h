@@ -1,17 +1,23 @@
 #pragma once
 
 #include <string>
-#include <fstream>
+#include <istream>
+#include <ostream>
 #include <vector>
+#include <sys/types.h>
 
 #include "NtfsStructs.h"
+#include "DirtyMap.h"
 
 /**
  * The class Partition is a wrapper for the ntfs partition file.
+ * All the partition file accesses are positional reads and writes on the file descriptor,
+ * so the calls don't share any seek pointer and can run concurrently from multiple threads,
+ * as long as the callers don't write the same regions at once. Only the format
+ * must run exclusively.
  */
 class Partition
 {
-    friend class NtfsChecker;
 public:
     /**
      * Initialize a Partition instance bound to the given file.
@@ -22,6 +28,11 @@ public:
      */
     explicit Partition(std::string path);
 
+    /**
+     * Close the partition file descriptor.
+     */
+    ~Partition();
+
     /**
      * Create a file if it doesn't exist or overwrite the old one,
      * compute required mft size, bitmap size, data segment size
@@ -46,14 +57,79 @@ public:
      */
     MftItem ReadMftItem(int32_t index);
 
+    /**
+     * Read the range of consecutive mft items from the partition at once.
+     *
+     * @param start The index of the first mft item to be read.
+     * @param count The number of mft items to be read.
+     *
+     * @throws PartitionMftOutOfBoundsException When the range is out of the mft bounds.
+     *
+     * @return The vector of read mft items.
+     */
+    std::vector<MftItem> ReadMftRange(int32_t start, int32_t count);
+
+    /**
+     * Read the range of consecutive mft items by the positional read on the partition file descriptor.
+     * The shared reads don't touch any partition state, so they can run on the const partition.
+     *
+     * @param start The index of the first mft item to be read.
+     * @param count The number of mft items to be read.
+     *
+     * @throws PartitionMftOutOfBoundsException When the range is out of the mft bounds.
+     * @throws PartitionReadException When the read fails.
+     *
+     * @return The mft items.
+     */
+    std::vector<MftItem> ReadMftRangeShared(int32_t start, int32_t count) const;
+
+    /**
+     * Read the range of the bitmap bits by the positional read.
+     *
+     * @param start The index of the first cluster.
+     * @param count The number of clusters.
+     *
+     * @throws PartitionBitmapOutOfBoundsException When the range is out of the bitmap bounds.
+     * @throws PartitionReadException When the read fails.
+     *
+     * @return The bits of the clusters.
+     */
+    std::vector<bool> ReadBitmapRangeShared(int32_t start, int32_t count) const;
+
+    /**
+     * Read the run of consecutive clusters by the positional read.
+     *
+     * @param index The index of the first cluster.
+     * @param destination The pointer to the data destination.
+     * @param dataSize The size of the data in bytes.
+     *
+     * @throws PartitionDataOutOfBoundsException When the data are out of the data segment bounds.
+     * @throws PartitionReadException When the read fails.
+     */
+    void ReadClusterRunShared(int32_t index, void *destination, size_t dataSize) const;
+
     /**
      * Read all mft items with the given uid from the partition
      * and sort them by their order.
-     * It calls the ReadMftItem function in the loop.
+     * It reads the mft in chunks by the ReadMftRange function
+     * and stops as soon as all the node mft items are found, unless the whole mft is requested.
+     * The checkers scan the whole mft, so they see the extra or duplicate items of a damaged node.
      *
-     * @param items The vector of MftItems to be read.
+     * @param uid The uid of the node which mft items will be read.
+     * @param wholeMft Whether to read every item of the uid instead of stopping at the item count.
      */
-    std::vector<MftItem> ReadMftItems(int32_t uid);
+    std::vector<MftItem> ReadMftItems(int32_t uid, bool wholeMft = false);
+
+    /**
+     * Find the first mft item of the node with the given uid.
+     * It reads the mft in chunks by the ReadMftRange function
+     * and stops as soon as the item is found.
+     *
+     * @param uid The uid of the node.
+     *
+     * @return The index of the mft item or MFT_INDEX_UNKNOWN if the node doesn't exist.
+     */
+    int32_t FindMftItem(int32_t uid);
 
     /**
      * Write the mft item into its position on the partition.
@@ -66,7 +142,7 @@ public:
 
     /**
      * Write the given mft items into their position on the partition.
-     * It calls the WriteMftItem function in the loop.
+     * The mft items with consecutive indexes are written at once.
      *
      * @param items The vector of MftItems to be written.
      */
@@ -83,6 +159,13 @@ public:
      */
     bool ReadBitmapBit(int32_t index);
 
+    /**
+     * Read the whole bitmap at once.
+     *
+     * @return The vector of bitmap bits indexed by the cluster index.
+     */
+    std::vector<bool> ReadBitmap();
+
     /**
      * Write the bitmap bit on the given index.
      *
@@ -93,6 +176,34 @@ public:
      */
     void WriteBitmapBit(int32_t index, bool bit);
 
+    /**
+     * Write the bitmap bits of the given run of clusters at once.
+     *
+     * @param start The index of the first bit in the bitmap.
+     * @param count The number of bits to be written.
+     * @param bit The value of the bits to be written.
+     *
+     * @throws PartitionBitmapOutOfBoundsException When the run is out of bounds.
+     */
+    void WriteBitmapRun(int32_t start, int32_t count, bool bit);
+
+    /**
+     * Copy the contents of the run of clusters into another run of clusters.
+     * The data are copied inside the kernel by copy_file_range if possible,
+     * otherwise through a buffer of COPY_BUFFER_CLUSTERS clusters.
+     * The runs must not overlap.
+     * It works on the file descriptor only, so the copies of disjoint runs can run in parallel.
+     *
+     * @param source The index of the first source cluster.
+     * @param destination The index of the first destination cluster.
+     * @param count The number of clusters to be copied.
+     *
+     * @throws PartitionDataOutOfBoundsException When one of the runs is out of bounds.
+     * @throws PartitionReadException When the buffered copy fails to read.
+     * @throws PartitionTransferException When the buffered copy fails to write.
+     */
+    void CopyClusters(int32_t source, int32_t destination, int32_t count);
+
     /**
      * Read the data from the cluster into the destination address.
      *
@@ -105,6 +216,32 @@ public:
      */
     void ReadCluster(int32_t index, void *destination, size_t dataSize);
 
+    /**
+     * Read the data from the run of consecutive clusters into the destination address at once.
+     *
+     * @param index The index of the first cluster of the run.
+     * @param offset The offset of the data in bytes from the start of the first cluster.
+     * @param destination The pointer to the data destination.
+     * @param dataSize The size of the data in bytes.
+     *
+     * @throws PartitionDataOutOfBoundsException When the data are out of the data segment bounds.
+     */
+    void ReadClusterRun(int32_t index, int32_t offset, void *destination, size_t dataSize);
+
+    /**
+     * Copy the data from the run of consecutive clusters into the given file descriptor.
+     * The data are moved inside the kernel by copy_file_range or sendfile if possible,
+     * otherwise they are copied through a bounded buffer.
+     *
+     * @param index The index of the first cluster of the run.
+     * @param dataSize The size of the data in bytes.
+     * @param destination The destination file descriptor, written at its current offset.
+     *
+     * @throws PartitionDataOutOfBoundsException When the data are out of the data segment bounds.
+     * @throws PartitionTransferException When the copying fails.
+     */
+    void ExportClusterRun(int32_t index, size_t dataSize, int destination);
+
     /**
      * Read the data from the clusters into the destination address.
      * It calls the ReadCluster function in the loop.
@@ -141,6 +278,35 @@ public:
      */
     void WriteCluster(int32_t index, const void *source, size_t dataSize);
 
+    /**
+     * Write the data from the source address into the run of consecutive clusters at once.
+     *
+     * @param index The index of the first cluster of the run.
+     * @param offset The offset of the data in bytes from the start of the first cluster.
+     * @param source The pointer to the data source.
+     * @param dataSize The size of the data in bytes.
+     *
+     * @throws PartitionDataOutOfBoundsException When the data are out of the data segment bounds.
+     */
+    void WriteClusterRun(int32_t index, int32_t offset, const void *source, size_t dataSize);
+
+    /**
+     * Copy the data from the given file descriptor into the run of consecutive clusters
+     * inside the kernel by copy_file_range, which writes on the given position only.
+     * The copying stops when the kernel can't copy from the source,
+     * the rest of the data is left to be copied by the caller.
+     *
+     * @param index The index of the first cluster of the run.
+     * @param dataSize The size of the data in bytes.
+     * @param source The source file descriptor, read from its current offset.
+     *
+     * @throws PartitionDataOutOfBoundsException When the data are out of the data segment bounds.
+     * @throws PartitionTransferException When the source ends too early.
+     *
+     * @return The number of bytes copied.
+     */
+    size_t ImportClusterRun(int32_t index, size_t dataSize, int source);
+
     /**
      * Write the data from the source address into the clusters.
      * It calls the WriteCluster function in the loop.
@@ -260,6 +426,23 @@ public:
      */
     int32_t GetPartitionSize() const;
 
+    /**
+     * Get the actual size of the partition file.
+     *
+     * @throws PartitionFileNotOpenedException When the partition file isn't opened.
+     *
+     * @return The file size in bytes.
+     */
+    off_t GetFileSize() const;
+
+    /**
+     * Get the map of the mft items and directories touched since the last successful check.
+     * The written mft items are marked by the partition itself.
+     *
+     * @return The dirty map.
+     */
+    DirtyMap &GetDirtyMap();
+
 private:
     /**
      * The ntfs partition file path.
@@ -267,15 +450,20 @@ private:
     std::string m_path;
 
     /**
-     * The ntfs partition file stream.
+     * The ntfs partition file descriptor, negative when the partition isn't opened.
      */
-    std::fstream m_file;
+    int m_fd{-1};
 
     /**
      * The ntfs boot record loaded from the partition file.
      */
     boot_record m_bootRecord;
 
+    /**
+     * The map of the changes since the last successful check.
+     */
+    DirtyMap m_dirtyMap;
+
     /**
      * Read data from the given position on the partition.
      *
@@ -300,6 +488,54 @@ private:
      */
     void Write(int32_t position, const void *source, size_t size);
 
+    /**
+     * Read data from the given position on the partition by the positional read on the file descriptor.
+     *
+     * @param position The read position.
+     * @param destination The pointer to the data destination.
+     * @param size The size of the data in bytes.
+     *
+     * @throws PartitionReadException When the read fails or the data end early.
+     */
+    void ReadShared(off_t position, void *destination, size_t size) const;
+
+    /**
+     * Write data to the given position on the partition by the positional write on the file descriptor.
+     *
+     * @param position The write position.
+     * @param source The pointer to the data source.
+     * @param size The size of the data in bytes.
+     *
+     * @throws PartitionTransferException When the write fails.
+     */
+    void WriteShared(off_t position, const void *source, size_t size);
+
+    /**
+     * Open the partition file descriptor, the previous one is closed.
+     *
+     * @param flags The open flags.
+     *
+     * @throws PartitionFileNotOpenedException When the file can't be opened.
+     */
+    void OpenDescriptor(int flags);
+
+    /**
+     * Close the partition file descriptor if it is opened.
+     */
+    void CloseDescriptor();
+
+    /**
+     * Get the address of the cluster run on the partition and check its bounds.
+     *
+     * @param index The index of the first cluster of the run.
+     * @param dataSize The size of the data in bytes.
+     *
+     * @throws PartitionDataOutOfBoundsException When the data are out of the data segment bounds.
+     *
+     * @return The address of the first cluster.
+     */
+    off_t GetClusterRunAddress(int32_t index, size_t dataSize) const;
+
     /**
      * Do a basic boot record values validation.
      *
@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Scrubber.h"
+#include "NodeInvariants.h"
+#include "Exceptions/PartitionExceptions.h"
+
+// done
+Scrubber::Scrubber(Ntfs &ntfs)
+    : m_ntfs(ntfs)
+{}
+
+// done
+Scrubber::~Scrubber()
+{
+    Stop();
+}
+
+// done
+void Scrubber::Start(int64_t rate)
+{
+    // the metadata lock goes first, as in the format, which stops the scrubber under it
+    Ntfs::SharedLock metadataLock{m_ntfs.m_metadataMutex};
+    std::lock_guard<std::mutex> controlLock{m_controlMutex};
+    StopThread();
+
+    if (!m_ntfs.m_partition.IsOpened()) {
+        throw PartitionFileNotOpenedException{"partition file is not opened, probably not formatted"};
+    }
+
+    m_rate = rate;
+    m_passes = 0;
+    m_checkedItems = 0;
+    m_checkedClusters = 0;
+    m_bytesRead = 0;
+    m_errors = 0;
+
+    {
+        std::lock_guard<std::mutex> lock{m_errorMutex};
+        m_lastError.clear();
+    }
+
+    m_stopping = false;
+    m_thread = std::thread{&Scrubber::Loop, this};
+}
+
+// done
+void Scrubber::Stop()
+{
+    std::lock_guard<std::mutex> lock{m_controlMutex};
+    StopThread();
+}
+
+// done
+void Scrubber::StopThread()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{m_waitMutex};
+        m_stopping = true;
+    }
+
+    m_wakeUp.notify_all();
+    m_thread.join();
+}
+
+// done
+Scrubber::Status Scrubber::GetStatus() const
+{
+    Ntfs::SharedLock metadataLock{m_ntfs.m_metadataMutex};
+    std::lock_guard<std::mutex> controlLock{m_controlMutex};
+    bool opened = m_ntfs.m_partition.IsOpened();
+
+    Status status{
+        m_thread.joinable(),
+        m_rate,
+        m_passes,
+        m_checkedItems,
+        opened ? m_ntfs.m_partition.GetMftItemCount() : 0,
+        m_checkedClusters,
+        opened ? m_ntfs.m_partition.GetClusterCount() : 0,
+        m_bytesRead,
+        m_errors,
+        {}};
+
+    std::lock_guard<std::mutex> lock{m_errorMutex};
+    status.lastError = m_lastError;
+
+    return status;
+}
+
+// done
+void Scrubber::Loop()
+{
+    // lower the priority of this thread only, the foreground keeps its own
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), SCRUB_NICENESS);
+
+    int32_t clusterSize;
+
+    {
+        Ntfs::SharedLock lock{m_ntfs.m_metadataMutex, std::defer_lock};
+
+        if (!LockMetadata(lock)) {
+            return;
+        }
+
+        clusterSize = m_ntfs.m_partition.GetClusterSize();
+    }
+
+    TokenBucket bucket{m_rate, COPY_BUFFER_CLUSTERS * clusterSize};
+
+    while (!m_stopping) {
+        m_checkedItems = 0;
+        m_checkedClusters = 0;
+
+        if (!ScrubMft(bucket) || !ScrubData(bucket)) {
+            return;
+        }
+
+        m_passes++;
+    }
+}
+
+// done
+bool Scrubber::ScrubMft(TokenBucket &bucket)
+{
+    for (int32_t start = 0;; start += MFT_READ_CHUNK_SIZE) {
+        // the lock isn't held while waiting, so the whole chunk is paid in advance
+        if (!Throttle(MFT_READ_CHUNK_SIZE * sizeof(mft_item), bucket)) {
+            return false;
+        }
+
+        Ntfs::SharedLock lock{m_ntfs.m_metadataMutex, std::defer_lock};
+
+        if (!LockMetadata(lock)) {
+            return false;
+        }
+
+        // the geometry is read under the lock, the format changes it only under the exclusive one
+        int32_t mftItemCount = m_ntfs.m_partition.GetMftItemCount();
+
+        if (start >= mftItemCount) {
+            return true;
+        }
+
+        int32_t count = std::min(MFT_READ_CHUNK_SIZE, mftItemCount - start);
+
+        try {
+            auto chunk = m_ntfs.m_partition.ReadMftRangeShared(start, count);
+
+            for (auto &mftItem : chunk) {
+                if (mftItem.item.uid != UID_ITEM_FREE) {
+                    CheckItem(mftItem);
+                }
+            }
+        }
+        catch (AppException &exception) {
+            ReportError(exception.what());
+        }
+
+        m_bytesRead += count * sizeof(mft_item);
+        m_checkedItems += count;
+    }
+}
+
+// done
+bool Scrubber::ScrubData(TokenBucket &bucket)
+{
+    for (int32_t groupStart = 0;; groupStart += SCRUB_GROUP_SIZE) {
+        int32_t groupSize;
+        int32_t clusterSize;
+        std::vector<bool> bits;
+
+        {
+            Ntfs::SharedLock lock{m_ntfs.m_metadataMutex, std::defer_lock};
+
+            if (!LockMetadata(lock)) {
+                return false;
+            }
+
+            int32_t clusterCount = m_ntfs.m_partition.GetClusterCount();
+
+            if (groupStart >= clusterCount) {
+                return true;
+            }
+
+            groupSize = std::min(SCRUB_GROUP_SIZE, clusterCount - groupStart);
+            clusterSize = m_ntfs.m_partition.GetClusterSize();
+
+            try {
+                bits = m_ntfs.m_partition.ReadBitmapRangeShared(groupStart, groupSize);
+            }
+            catch (AppException &exception) {
+                ReportError(exception.what());
+                m_checkedClusters += groupSize;
+                continue;
+            }
+        }
+
+        // read the runs of the used clusters within the group
+        for (int32_t i = 0; i < groupSize;) {
+            if (bits[i] == BIT_CLUSTER_FREE) {
+                i++;
+                continue;
+            }
+
+            int32_t runStart = i;
+
+            while (i < groupSize && bits[i] != BIT_CLUSTER_FREE) {
+                i++;
+            }
+
+            if (!ReadRun(groupStart + runStart, i - runStart, clusterSize, bucket)) {
+                return false;
+            }
+        }
+
+        m_checkedClusters += groupSize;
+    }
+}
+
+// done
+void Scrubber::CheckItem(const MftItem &mftItem)
+{
+    const mft_item &item = mftItem.item;
+    std::string itemName = "the mft item " + std::to_string(mftItem.index) + " of the node " + std::to_string(item.uid);
+
+    if (item.count < 1 || item.order < 0 || item.order >= item.count) {
+        ReportError(itemName + " has the order " + std::to_string(item.order)
+                        + " out of " + std::to_string(item.count) + " items");
+    }
+
+    if (item.name[NODE_NAME_SIZE - 1] != '\0') {
+        ReportError(itemName + " has the name not terminated");
+    }
+
+    int32_t clusterCount = m_ntfs.m_partition.GetClusterCount();
+    int32_t nodeClusterCount{0};
+    int i = 0;
+
+    for (; i < MFT_FRAGMENTS_COUNT && item.fragments[i].start != FRAGMENT_UNUSED_START; i++) {
+        const mft_fragment &fragment = item.fragments[i];
+
+        if (!NodeInvariants::IsFragmentInBounds(fragment, clusterCount)) {
+            ReportError(itemName + " has the fragment [start=" + std::to_string(fragment.start)
+                            + ", count=" + std::to_string(fragment.count) + "] out of the data segment");
+            continue;
+        }
+
+        auto bits = m_ntfs.m_partition.ReadBitmapRangeShared(fragment.start, fragment.count);
+
+        if (std::find(bits.begin(), bits.end(), BIT_CLUSTER_FREE) != bits.end()) {
+            ReportError(itemName + " owns the clusters [start=" + std::to_string(fragment.start)
+                            + ", count=" + std::to_string(fragment.count) + "] not all marked as used");
+        }
+
+        nodeClusterCount += fragment.count;
+    }
+
+    // the fragments behind the first unused one must be unused too
+    for (; i < MFT_FRAGMENTS_COUNT; i++) {
+        if (item.fragments[i].start != FRAGMENT_UNUSED_START) {
+            ReportError(itemName + " has a used fragment behind the unused one");
+            break;
+        }
+    }
+
+    if (item.count == 1) {
+        int32_t clusterSize = m_ntfs.m_partition.GetClusterSize();
+
+        if (NodeInvariants::CompareClustersWithSize(nodeClusterCount, item.size, clusterSize) != 0) {
+            ReportError(itemName + " has " + std::to_string(nodeClusterCount) + " clusters"
+                            + " - not corresponding with the node size " + std::to_string(item.size) + " bytes");
+        }
+    }
+}
+
+// done
+bool Scrubber::ReadRun(int32_t start, int32_t count, int32_t clusterSize, TokenBucket &bucket)
+{
+    std::vector<char> buffer;
+    buffer.resize(static_cast<size_t>(std::min(count, COPY_BUFFER_CLUSTERS) * clusterSize));
+
+    for (int32_t done = 0; done < count;) {
+        int32_t toRead = std::min(count - done, COPY_BUFFER_CLUSTERS);
+        size_t dataSize = static_cast<size_t>(toRead) * clusterSize;
+
+        if (!Throttle(dataSize, bucket)) {
+            return false;
+        }
+
+        Ntfs::SharedLock lock{m_ntfs.m_metadataMutex, std::defer_lock};
+
+        if (!LockMetadata(lock)) {
+            return false;
+        }
+
+        if (m_ntfs.m_partition.GetClusterSize() != clusterSize
+            || start + done > m_ntfs.m_partition.GetClusterCount() - toRead) {
+            // the partition was recreated, the rest of the run is gone
+            return true;
+        }
+
+        try {
+            m_ntfs.m_partition.ReadClusterRunShared(start + done, buffer.data(), dataSize);
+        }
+        catch (AppException &exception) {
+            ReportError("the clusters [start=" + std::to_string(start + done)
+                            + ", count=" + std::to_string(toRead) + "] can't be read: " + exception.what());
+        }
+
+        m_bytesRead += dataSize;
+        done += toRead;
+    }
+
+    return true;
+}
+
+// done
+bool Scrubber::Throttle(size_t bytes, TokenBucket &bucket)
+{
+    auto wait = bucket.Consume(static_cast<int64_t>(bytes));
+
+    std::unique_lock<std::mutex> lock{m_waitMutex};
+
+    if (wait.count() > 0) {
+        m_wakeUp.wait_for(lock, wait, [this]() {
+            return m_stopping.load();
+        });
+    }
+
+    return !m_stopping;
+}
+
+// done
+bool Scrubber::LockMetadata(Ntfs::SharedLock &lock)
+{
+    // poll, so the stop isn't blocked by a long foreground command
+    while (!lock.try_lock_for(std::chrono::milliseconds{SCRUB_LOCK_POLL_MS})) {
+        if (m_stopping) {
+            return false;
+        }
+    }
+
+    return !m_stopping;
+}
+
+// done
+void Scrubber::ReportError(const std::string &message)
+{
+    m_errors++;
+
+    std::lock_guard<std::mutex> lock{m_errorMutex};
+    m_lastError = message;
+}
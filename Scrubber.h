@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "Ntfs.h"
+#include "TokenBucket.h"
+
+/**
+ * Class Scrubber keeps walking the partition in a low priority background thread.
+ * It validates the mft items against the bitmap chunk by chunk and reads every allocated cluster,
+ * so the unreadable clusters and the broken metadata are found early.
+ * The scrubber reads only by the shared partition reads and its reads are throttled by a token bucket.
+ * Every chunk is read under the shared ntfs metadata lock together with the partition geometry,
+ * so the scrubber never sees a half written metadata change nor walks the geometry of a replaced partition.
+ */
+class Scrubber
+{
+public:
+    /**
+     * The structure of the scrubber progress and error counters.
+     */
+    struct Status
+    {
+        bool running;                                   // whether the scrubber thread runs
+        int64_t rate;                                   // the max number of bytes read per second
+        int64_t passes;                                 // the number of finished passes over the partition
+        int64_t checkedItems;                           // the number of mft items checked in the current pass
+        int64_t mftItemCount;                           // the total number of mft items
+        int64_t checkedClusters;                        // the number of clusters checked in the current pass
+        int64_t clusterCount;                           // the total number of clusters
+        int64_t bytesRead;                              // the total number of bytes read
+        int64_t errors;                                 // the total number of errors found
+        std::string lastError;                          // the message of the last error
+    };
+
+    /**
+     * Initializes a new stopped Scrubber.
+     *
+     * @param ntfs The ntfs which the scrubber will operate on.
+     */
+    explicit Scrubber(Ntfs &ntfs);
+
+    /**
+     * Stop the scrubber thread.
+     */
+    ~Scrubber();
+
+    /**
+     * Start the scrubber thread, the running one is restarted with the new rate.
+     * The counters are reset.
+     *
+     * @param rate The max number of bytes read per second.
+     *
+     * @throws PartitionFileNotOpenedException When the partition isn't opened.
+     */
+    void Start(int64_t rate);
+
+    /**
+     * Stop the scrubber thread and wait for it.
+     */
+    void Stop();
+
+    /**
+     * Get the current progress and error counters.
+     *
+     * @return The scrubber status.
+     */
+    Status GetStatus() const;
+
+private:
+    /**
+     * The ntfs which the scrubber operates on.
+     */
+    Ntfs &m_ntfs;
+
+    /**
+     * The scrubber thread.
+     */
+    std::thread m_thread;
+
+    /**
+     * The mutex serializing the starts and stops of the scrubber thread from multiple shells.
+     */
+    mutable std::mutex m_controlMutex;
+
+    /**
+     * The mutex for waiting in the throttling.
+     */
+    std::mutex m_waitMutex;
+
+    /**
+     * The condition variable to wake up the waiting scrubber thread when it is stopped.
+     */
+    std::condition_variable m_wakeUp;
+
+    /**
+     * Whether the scrubber thread should stop.
+     */
+    std::atomic<bool> m_stopping{false};
+
+    /**
+     * The max number of bytes read per second.
+     */
+    std::atomic<int64_t> m_rate{0};
+
+    /**
+     * The number of finished passes.
+     */
+    std::atomic<int64_t> m_passes{0};
+
+    /**
+     * The number of mft items checked in the current pass.
+     */
+    std::atomic<int64_t> m_checkedItems{0};
+
+    /**
+     * The number of clusters checked in the current pass.
+     */
+    std::atomic<int64_t> m_checkedClusters{0};
+
+    /**
+     * The total number of bytes read.
+     */
+    std::atomic<int64_t> m_bytesRead{0};
+
+    /**
+     * The total number of errors found.
+     */
+    std::atomic<int64_t> m_errors{0};
+
+    /**
+     * The mutex guarding the last error message.
+     */
+    mutable std::mutex m_errorMutex;
+
+    /**
+     * The message of the last error.
+     */
+    std::string m_lastError;
+
+    /**
+     * Run the passes until the scrubber is stopped.
+     */
+    void Loop();
+
+    /**
+     * Validate the mft items chunk by chunk, the mft size is read with every chunk.
+     *
+     * @param bucket The token bucket throttling the reads.
+     *
+     * @return False if the scrubber was stopped, true otherwise.
+     */
+    bool ScrubMft(TokenBucket &bucket);
+
+    /**
+     * Read all the allocated clusters group by group, the cluster count is read with every group.
+     *
+     * @param bucket The token bucket throttling the reads.
+     *
+     * @return False if the scrubber was stopped, true otherwise.
+     */
+    bool ScrubData(TokenBucket &bucket);
+
+    /**
+     * Validate the used mft item - its order, fragments, their clusters in the bitmap
+     * and the size of the node with a single mft item.
+     *
+     * @param mftItem The mft item.
+     */
+    void CheckItem(const MftItem &mftItem);
+
+    /**
+     * Read the run of clusters piece by piece, every piece under the shared metadata lock.
+     * The rest of the run is skipped if the partition geometry has changed meanwhile.
+     *
+     * @param start The first cluster of the run.
+     * @param count The number of clusters in the run.
+     * @param clusterSize The cluster size read together with the run.
+     * @param bucket The token bucket throttling the reads.
+     *
+     * @return False if the scrubber was stopped, true otherwise.
+     */
+    bool ReadRun(int32_t start, int32_t count, int32_t clusterSize, TokenBucket &bucket);
+
+    /**
+     * Stop the scrubber thread and wait for it, the control mutex is held by the caller.
+     */
+    void StopThread();
+
+    /**
+     * Take the tokens for the read and wait while the bucket is in debt.
+     *
+     * @param bytes The number of bytes to be read.
+     * @param bucket The token bucket.
+     *
+     * @return False if the scrubber was stopped while waiting, true otherwise.
+     */
+    bool Throttle(size_t bytes, TokenBucket &bucket);
+
+    /**
+     * Lock the ntfs metadata shared, it gives up when the scrubber is stopped.
+     *
+     * @param lock The shared lock of the ntfs metadata.
+     *
+     * @return False if the scrubber was stopped, true when locked.
+     */
+    bool LockMetadata(Ntfs::SharedLock &lock);
+
+    /**
+     * Count the error and remember its message.
+     *
+     * @param message The error message.
+     */
+    void ReportError(const std::string &message);
+};
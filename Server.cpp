@@ -0,0 +1,328 @@
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "Server.h"
+#include "Exceptions/ServerExceptions.h"
+
+namespace
+{
+    /**
+     * The write end of the pipe waking up the poll loop of the running server on a signal.
+     */
+    volatile sig_atomic_t signalPipe{-1};
+
+    /**
+     * Wake up the poll loop of the running server.
+     *
+     * @param signal The received signal.
+     */
+    void HandleSignal(int signal)
+    {
+        int savedErrno = errno;
+
+        if (signalPipe >= 0) {
+            char byte = static_cast<char>(signal);
+            ssize_t ignored = write(signalPipe, &byte, 1);
+            (void) ignored;
+        }
+
+        errno = savedErrno;
+    }
+}
+
+// done
+Server::Client::Client(int fd, Ntfs &ntfs, Scrubber &scrubber)
+    : fd{fd},
+      ntfs(ntfs),
+      session{ntfs.CreateSession()},
+      shell{ntfs, scrubber, input, output}
+{}
+
+// done
+Server::Client::~Client()
+{
+    // the client may be gone without closing its files
+    ntfs.CloseSession(session);
+    close(fd);
+}
+
+// done
+Server::Server(Ntfs &ntfs, ThreadPool &sessionPool, std::string socketPath)
+    : m_ntfs(ntfs),
+      m_sessionPool(sessionPool),
+      m_socketPath(std::move(socketPath)),
+      m_scrubber(m_ntfs)
+{}
+
+// done
+Server::~Server()
+{
+    if (m_socket >= 0) {
+        close(m_socket);
+        unlink(m_socketPath.c_str());
+    }
+}
+
+// done
+void Server::Run()
+{
+    Listen();
+
+    int wakeUp[2];
+
+    if (pipe2(wakeUp, O_CLOEXEC | O_NONBLOCK) != 0) {
+        throw ServerSocketException{"can't create the pipe: " + std::string{std::strerror(errno)}};
+    }
+
+    // the signals only wake up the poll loop, which stops the server
+    struct sigaction action{};
+    struct sigaction previousInterrupt{};
+    struct sigaction previousTerminate{};
+
+    action.sa_handler = HandleSignal;
+    sigemptyset(&action.sa_mask);
+
+    signalPipe = wakeUp[1];
+    sigaction(SIGINT, &action, &previousInterrupt);
+    sigaction(SIGTERM, &action, &previousTerminate);
+
+    while (true) {
+        std::vector<pollfd> fds{{m_socket, POLLIN, 0}, {wakeUp[0], POLLIN, 0}};
+
+        for (auto &client : m_clients) {
+            fds.push_back({client.first, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        if (fds[1].revents != 0) {
+            // stop requested
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            Accept();
+        }
+
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+
+            auto found = m_clients.find(fds[i].fd);
+
+            if (!Receive(found->second)) {
+                // the client is closed when its last session task ends
+                m_clients.erase(found);
+            }
+        }
+    }
+
+    sigaction(SIGINT, &previousInterrupt, nullptr);
+    sigaction(SIGTERM, &previousTerminate, nullptr);
+    signalPipe = -1;
+
+    close(wakeUp[0]);
+    close(wakeUp[1]);
+
+    // drop the queued commands and let the running ones finish
+    for (auto &client : m_clients) {
+        std::lock_guard<std::mutex> lock{client.second->mutex};
+        client.second->terminated = true;
+    }
+
+    m_clients.clear();
+
+    m_sessionPool.WaitUntil([this]() {
+        return m_pending == 0;
+    });
+}
+
+// done
+void Server::Listen()
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (m_socketPath.size() >= sizeof(address.sun_path)) {
+        throw ServerSocketException{"the socket path " + m_socketPath + " is too long"};
+    }
+
+    std::strncpy(address.sun_path, m_socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    // remove the socket left by a previous server, but never a regular file
+    struct stat status{};
+
+    if (lstat(m_socketPath.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+        unlink(m_socketPath.c_str());
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        throw ServerSocketException{"can't create the socket: " + std::string{std::strerror(errno)}};
+    }
+
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        std::string error{std::strerror(errno)};
+        close(fd);
+        throw ServerSocketException{"can't bind the socket " + m_socketPath + ": " + error};
+    }
+
+    m_socket = fd;
+
+    if (listen(m_socket, SERVER_BACKLOG) != 0) {
+        throw ServerSocketException{"can't listen on the socket " + m_socketPath + ": " + std::strerror(errno)};
+    }
+}
+
+// done
+void Server::Accept()
+{
+    int fd = accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+
+    if (fd < 0) {
+        return;
+    }
+
+    auto client = std::make_shared<Client>(fd, m_ntfs, m_scrubber);
+    m_clients.emplace(fd, client);
+
+    Send(fd, client->shell.GetPrompt());
+}
+
+// done
+bool Server::Receive(const std::shared_ptr<Client> &client)
+{
+    char buffer[SERVER_READ_SIZE];
+    ssize_t count = read(client->fd, buffer, sizeof(buffer));
+
+    if (count < 0 && errno == EINTR) {
+        return true;
+    }
+
+    if (count <= 0) {
+        return false;
+    }
+
+    client->received.append(buffer, static_cast<size_t>(count));
+
+    // split the complete lines
+    std::vector<std::string> lines;
+    size_t start = 0;
+
+    for (size_t end; (end = client->received.find('\n', start)) != std::string::npos; start = end + 1) {
+        lines.emplace_back(client->received, start, end - start);
+    }
+
+    client->received.erase(0, start);
+
+    if (client->received.size() > SERVER_MAX_LINE_LENGTH) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock{client->mutex};
+
+    if (client->terminated) {
+        return false;
+    }
+
+    for (auto &line : lines) {
+        client->commands.emplace_back(std::move(line));
+    }
+
+    if (!client->busy && !client->commands.empty()) {
+        // only one session task per client, so its commands keep their order
+        client->busy = true;
+        m_pending++;
+
+        m_sessionPool.Submit([this, client]() {
+            Serve(client);
+        });
+    }
+
+    return true;
+}
+
+// done
+void Server::Serve(std::shared_ptr<Client> client)
+{
+    Ntfs::SessionScope session{client->session, client->currentDirectory};
+
+    while (true) {
+        std::string line;
+
+        {
+            std::lock_guard<std::mutex> lock{client->mutex};
+
+            if (client->commands.empty() || client->terminated) {
+                client->busy = false;
+                break;
+            }
+
+            line = std::move(client->commands.front());
+            client->commands.pop_front();
+        }
+
+        try {
+            client->shell.Handle(line);
+        }
+        catch (std::exception &exception) {
+            client->output << "ERROR: " << exception.what() << std::endl;
+        }
+
+        if (client->shell.IsTerminated()) {
+            Send(client->fd, client->output.str());
+
+            std::lock_guard<std::mutex> lock{client->mutex};
+            client->terminated = true;
+            client->commands.clear();
+
+            // the poll loop sees the end of the connection and drops the client
+            shutdown(client->fd, SHUT_RDWR);
+            continue;
+        }
+
+        client->output << client->shell.GetPrompt();
+        Send(client->fd, client->output.str());
+        client->output.str("");
+    }
+
+    m_pending--;
+}
+
+// done
+void Server::Send(int fd, const std::string &data)
+{
+    const char *buffer = data.data();
+    size_t remaining = data.size();
+
+    while (remaining > 0) {
+        ssize_t sent = send(fd, buffer, remaining, MSG_NOSIGNAL);
+
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (sent <= 0) {
+            return;
+        }
+
+        buffer += sent;
+        remaining -= static_cast<size_t>(sent);
+    }
+}
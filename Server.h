@@ -0,0 +1,159 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <sstream>
+
+#include "Ntfs.h"
+#include "Scrubber.h"
+#include "Shell.h"
+#include "ThreadPool.h"
+
+/**
+ * Class Server serves the shell commands of many local clients over a unix domain socket.
+ * Every client has its own shell, its own ntfs session with the current working directory and the open files,
+ * which are closed when the client is dropped. It sends the command lines
+ * and receives the shell output of every command followed by the prompt, as in the interactive shell.
+ * The poll loop reads the commands and dispatches them to the session pool, so the commands
+ * of different clients run concurrently, while the commands of one client run in order.
+ * The session pool must not be the pool of the ntfs, otherwise a session holding the metadata lock
+ * could be run nested by a worker waiting for its subtasks under the same lock.
+ */
+class Server
+{
+public:
+    /**
+     * Initializes a new Server of the given ntfs.
+     *
+     * @param ntfs The ntfs which the clients operate on.
+     * @param sessionPool The thread pool running the client commands.
+     * @param socketPath The path of the unix domain socket.
+     */
+    Server(Ntfs &ntfs, ThreadPool &sessionPool, std::string socketPath);
+
+    /**
+     * Close the socket and remove its file.
+     */
+    ~Server();
+
+    Server(const Server &) = delete;
+
+    Server &operator=(const Server &) = delete;
+
+    /**
+     * Listen on the socket and serve the clients until the SIGINT or SIGTERM is received.
+     * The running commands are finished before it returns, the queued ones are dropped.
+     *
+     * @throws ServerSocketException When the socket can't be created.
+     */
+    void Run();
+
+private:
+    /**
+     * The structure of a connected client.
+     */
+    struct Client
+    {
+        /**
+         * Initializes a new Client with a new ntfs session and the shell in the root directory.
+         *
+         * @param fd The client socket.
+         * @param ntfs The ntfs which the client operates on.
+         * @param scrubber The scrubber shared by the clients.
+         */
+        Client(int fd, Ntfs &ntfs, Scrubber &scrubber);
+
+        /**
+         * Close the files opened by the client and the client socket.
+         */
+        ~Client();
+
+        int fd;                                         // the client socket
+        Ntfs &ntfs;                                     // the ntfs which the client operates on
+        int32_t session;                                // the ntfs session of the client
+        std::string received;                           // the received data after the last complete line
+        std::mutex mutex;                               // the lock of the commands and the flags
+        std::deque<std::string> commands;               // the command lines waiting for the session
+        bool busy{false};                               // whether a session task runs the commands
+        bool terminated{false};                         // whether the client exited or the server stops
+        int32_t currentDirectory{UID_ROOT};             // the uid of the client working directory
+        std::istringstream input;                       // the unused shell input
+        std::ostringstream output;                      // the shell output of the running command
+        Shell shell;                                    // the client shell
+    };
+
+    /**
+     * The ntfs which the clients operate on.
+     */
+    Ntfs &m_ntfs;
+
+    /**
+     * The thread pool running the client commands.
+     */
+    ThreadPool &m_sessionPool;
+
+    /**
+     * The path of the unix domain socket.
+     */
+    std::string m_socketPath;
+
+    /**
+     * The listening socket.
+     */
+    int m_socket{-1};
+
+    /**
+     * The background scrubber shared by the clients.
+     */
+    Scrubber m_scrubber;
+
+    /**
+     * The connected clients by their sockets, only the poll loop accesses it.
+     */
+    std::map<int, std::shared_ptr<Client>> m_clients;
+
+    /**
+     * The number of the session tasks not finished yet.
+     */
+    std::atomic<size_t> m_pending{0};
+
+    /**
+     * Create the socket, bind it to the path and start listening.
+     *
+     * @throws ServerSocketException When the socket can't be created.
+     */
+    void Listen();
+
+    /**
+     * Accept a new client and send it the prompt.
+     */
+    void Accept();
+
+    /**
+     * Read the data from the client and dispatch its complete command lines.
+     *
+     * @param client The client.
+     *
+     * @return False if the client closed the connection or should be disconnected, true otherwise.
+     */
+    bool Receive(const std::shared_ptr<Client> &client);
+
+    /**
+     * Run the queued commands of the client in order, it is run as a session task.
+     *
+     * @param client The client.
+     */
+    void Serve(std::shared_ptr<Client> client);
+
+    /**
+     * Send the whole data to the socket, the errors are ignored as the client may be gone.
+     *
+     * @param fd The socket.
+     * @param data The data.
+     */
+    void Send(int fd, const std::string &data);
+};
@@ -1,4 +1,10 @@
 #include <iostream>
+#include <iterator>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "Shell.h"
 #include "Exceptions/ShellExceptions.h"
@@ -10,7 +16,18 @@ Shell::Shell(Ntfs &ntfs, std::istream &input, std::ostream &output)
     : m_input(input),
       m_output(output),
       m_ntfs(ntfs),
-      m_ntfsChecker(m_ntfs)
+      m_ntfsChecker(m_ntfs),
+      m_ownScrubber(new Scrubber{m_ntfs}),
+      m_scrubber(*m_ownScrubber)
+{}
+
+// done
+Shell::Shell(Ntfs &ntfs, Scrubber &scrubber, std::istream &input, std::ostream &output)
+    : m_input(input),
+      m_output(output),
+      m_ntfs(ntfs),
+      m_ntfsChecker(m_ntfs),
+      m_scrubber(scrubber)
 {}
 
 // done
@@ -31,22 +48,24 @@ void Shell::Run()
 }
 
 // done
-void Shell::Handle(std::string line)
+bool Shell::Handle(std::string line)
 {
+    m_error.clear();
+
     std::stringstream lineStream{line};
     std::vector<std::string> arguments{
         std::istream_iterator<std::string>{lineStream},
         std::istream_iterator<std::string>{}};
 
     if (arguments.empty()) {
-        return;
+        return true;
     }
 
     std::string commandName{arguments[0]};
 
     if (Shell::m_actions.find(commandName) == Shell::m_actions.end()) {
-        m_output << "UNKNOWN COMMAND" << std::endl;
-        return;
+        Fail("UNKNOWN COMMAND");
+        return false;
     }
 
     Command command = Shell::m_actions[commandName];
@@ -55,58 +74,43 @@ void Shell::Handle(std::string line)
         (this->*command)(arguments);
     }
     catch (AppException &exception) {
-        m_output << "ERROR: " << exception.what() << std::endl;
+        Fail(std::string{"ERROR: "} + exception.what());
     }
+
+    return m_error.empty();
 }
 
 // done
-void Shell::CmdExit(std::vector<std::string> arguments)
+bool Shell::IsTerminated() const
 {
-    if (arguments.size() != 1) {
-        throw ShellWrongArgumentsException("exit takes no arguments");
-    }
-
-    m_shouldTerminate = true;
+    return m_shouldTerminate;
 }
 
 // done
-void Shell::CmdLoad(std::vector<std::string> arguments)
+const std::string &Shell::GetError() const
 {
-    if (arguments.size() != 2) {
-        throw ShellWrongArgumentsException("load takes exactly one argument");
-    }
-
-    std::ifstream cmdFile{arguments[1]};
-
-    if (!cmdFile.is_open()) {
-        m_output << "FILE NOT FOUND" << std::endl;
-        return;
-    }
-
-    Shell subShell(m_ntfs, cmdFile, m_output);
-    subShell.Run();
+    return m_error;
 }
 
 // done
-void Shell::CmdOpened(std::vector<std::string> arguments)
+const std::string &Shell::GetPrompt() const
 {
-    if (arguments.size() != 1) {
-        throw ShellWrongArgumentsException("opened takes no arguments");
-    }
-
-    m_output << (m_ntfs.IsOpened() ? "YES" : "NO") << std::endl;
+    return m_prompt;
 }
 
 // done
-void Shell::CmdFormat(std::vector<std::string> arguments)
+void Shell::Fail(const std::string &message)
 {
-    if (arguments.size() != 2) {
-        throw ShellWrongArgumentsException("format takes exactly one argument");
-    }
+    m_error = message;
+    m_output << message << std::endl;
+}
 
+// done
+int64_t Shell::ParseSize(const std::string &text)
+{
     std::smatch match;
 
-    if (!std::regex_match(arguments[1], match, m_sizeRegex)) {
+    if (!std::regex_match(text, match, m_sizeRegex)) {
         throw ShellWrongArgumentsException("size is in bad format");
     }
 
@@ -134,20 +138,72 @@ void Shell::CmdFormat(std::vector<std::string> arguments)
         size *= 1000000000;
     }
 
+    return size;
+}
+
+// done
+void Shell::CmdExit(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 1) {
+        throw ShellWrongArgumentsException("exit takes no arguments");
+    }
+
+    m_shouldTerminate = true;
+}
+
+// done
+void Shell::CmdLoad(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 2) {
+        throw ShellWrongArgumentsException("load takes exactly one argument");
+    }
+
+    std::ifstream cmdFile{arguments[1]};
+
+    if (!cmdFile.is_open()) {
+        Fail("FILE NOT FOUND");
+        return;
+    }
+
+    Shell subShell(m_ntfs, m_scrubber, cmdFile, m_output);
+    subShell.Run();
+}
+
+// done
+void Shell::CmdOpened(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 1) {
+        throw ShellWrongArgumentsException("opened takes no arguments");
+    }
+
+    m_output << (m_ntfs.IsOpened() ? "YES" : "NO") << std::endl;
+}
+
+// done
+void Shell::CmdFormat(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 2) {
+        throw ShellWrongArgumentsException("format takes exactly one argument");
+    }
+
+    int64_t size = ParseSize(arguments[1]);
+
     if (size > INT32_MAX) {
         throw ShellWrongArgumentsException("size is too big");
     }
 
-
     std::string signature = "admin";
     std::string description = "pseudo ntfs partition";
 
     try {
-        m_ntfs.Format(static_cast<int32_t>(size), signature, description);
+        // the scrubber can't run over the partition being recreated
+        m_ntfs.Format(static_cast<int32_t>(size), signature, description, [this]() {
+            m_scrubber.Stop();
+        });
         m_output << "OK" << std::endl;
     }
     catch (PartitionFileNotOpenedException &exception) {
-        m_output << "CANNOT CREATE FILE" << std::endl;
+        Fail("CANNOT CREATE FILE");
     }
 }
 
@@ -171,7 +227,7 @@ void Shell::CmdCd(std::vector<std::string> arguments)
         m_ntfs.Cd(arguments[1]);
     }
     catch (NtfsPathNotFoundException &exception) {
-        m_output << "PATH NOT FOUND" << std::endl;
+        Fail("PATH NOT FOUND");
     }
 }
 
@@ -190,32 +246,32 @@ void Shell::CmdInfo(std::vector<std::string> arguments)
         m_output << "Type: " << (node.IsDirectory() ? "D" : "F") << std::endl;
         m_output << "Size: " << node.GetSize() << " B" << std::endl;
 
-        auto fragments = node.GetFragments();
+        auto extents = node.GetExtents();
 
-        m_output << "Fragments: (" << fragments.size() << ")" << std::endl;
+        m_output << "Fragments: (" << node.GetExtentCount() << ")" << std::endl;
 
-        for (auto &fragment : fragments) {
+        for (auto &fragment : extents) {
             m_output << "    [start=" << fragment.start << ", count=" << fragment.count << "]" << std::endl;
         }
 
-        auto clusters = node.GetClusters();
-
-        m_output << "Clusters: (" << clusters.size() << ")" << std::endl;
+        m_output << "Clusters: (" << node.GetClusterCount() << ")" << std::endl;
         m_output << "    ";
 
         bool first = true;
-        for (auto &cluster : clusters) {
-            if (!first) {
-                m_output << ", ";
-            } else {
-                first = false;
+        for (auto &fragment : extents) {
+            for (int32_t cluster = fragment.start; cluster < fragment.start + fragment.count; cluster++) {
+                if (!first) {
+                    m_output << ", ";
+                } else {
+                    first = false;
+                }
+                m_output << cluster;
             }
-            m_output << cluster;
         }
         m_output << std::endl;
     }
     catch (NtfsNodeNotFoundException &exception) {
-        m_output << "FILE NOT FOUND" << std::endl;
+        Fail("FILE NOT FOUND");
     }
 }
 
@@ -250,7 +306,7 @@ void Shell::CmdLs(std::vector<std::string> arguments)
         }
     }
     catch (NtfsPathNotFoundException &exception) {
-        m_output << "PATH NOT FOUND" << std::endl;
+        Fail("PATH NOT FOUND");
     }
 }
 
@@ -266,7 +322,207 @@ void Shell::CmdCat(std::vector<std::string> arguments)
         m_output << std::endl;
     }
     catch (NtfsFileNotFoundException &exception) {
-        m_output << "FILE NOT FOUND" << std::endl;
+        Fail("FILE NOT FOUND");
+    }
+}
+
+// done
+void Shell::CmdHead(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 2 && arguments.size() != 3) {
+        throw ShellWrongArgumentsException("head takes the file path and optionally the number of bytes");
+    }
+
+    int32_t length = arguments.size() == 3 ? ParseNumber(arguments[2], "length") : CLUSTER_SIZE;
+
+    try {
+        m_ntfs.Read(arguments[1], 0, length, m_output);
+        m_output << std::endl;
+    }
+    catch (NtfsFileNotFoundException &exception) {
+        Fail("FILE NOT FOUND");
+    }
+}
+
+// done
+void Shell::CmdTail(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 2 && arguments.size() != 3) {
+        throw ShellWrongArgumentsException("tail takes the file path and optionally the number of bytes");
+    }
+
+    int32_t length = arguments.size() == 3 ? ParseNumber(arguments[2], "length") : CLUSTER_SIZE;
+
+    try {
+        m_ntfs.ReadTail(arguments[1], length, m_output);
+        m_output << std::endl;
+    }
+    catch (NtfsFileNotFoundException &exception) {
+        Fail("FILE NOT FOUND");
+    }
+}
+
+// done
+void Shell::CmdRead(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 4) {
+        throw ShellWrongArgumentsException("read takes exactly three arguments");
+    }
+
+    int32_t offset = ParseNumber(arguments[2], "offset");
+    int32_t length = ParseNumber(arguments[3], "length");
+
+    try {
+        m_ntfs.Read(arguments[1], offset, length, m_output);
+        m_output << std::endl;
+    }
+    catch (NtfsFileNotFoundException &exception) {
+        Fail("FILE NOT FOUND");
+    }
+}
+
+// done
+void Shell::CmdWrite(std::vector<std::string> arguments)
+{
+    if (arguments.size() < 4) {
+        throw ShellWrongArgumentsException("write takes the file path, the offset and the text");
+    }
+
+    int32_t offset = ParseNumber(arguments[2], "offset");
+    std::stringstream text{JoinArguments(arguments, 3)};
+
+    try {
+        m_ntfs.Write(arguments[1], offset, text, static_cast<int32_t>(text.str().size()));
+        m_output << "OK" << std::endl;
+    }
+    catch (NtfsFileNotFoundException &exception) {
+        Fail("FILE NOT FOUND");
+    }
+}
+
+// done
+void Shell::CmdAppend(std::vector<std::string> arguments)
+{
+    if (arguments.size() < 3) {
+        throw ShellWrongArgumentsException("append takes the file path and the text");
+    }
+
+    std::stringstream text{JoinArguments(arguments, 2)};
+
+    try {
+        m_ntfs.Append(arguments[1], text, static_cast<int32_t>(text.str().size()));
+        m_output << "OK" << std::endl;
+    }
+    catch (NtfsFileNotFoundException &exception) {
+        Fail("FILE NOT FOUND");
+    }
+}
+
+// done
+void Shell::CmdTruncate(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 3) {
+        throw ShellWrongArgumentsException("truncate takes exactly two arguments");
+    }
+
+    int32_t size = ParseNumber(arguments[2], "size");
+
+    try {
+        m_ntfs.Truncate(arguments[1], size);
+        m_output << "OK" << std::endl;
+    }
+    catch (NtfsFileNotFoundException &exception) {
+        Fail("FILE NOT FOUND");
+    }
+}
+
+// done
+void Shell::CmdOpen(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 2) {
+        throw ShellWrongArgumentsException("open takes exactly one argument");
+    }
+
+    try {
+        m_output << m_ntfs.Open(arguments[1]) << std::endl;
+    }
+    catch (NtfsFileNotFoundException &exception) {
+        Fail("FILE NOT FOUND");
+    }
+}
+
+// done
+void Shell::CmdFread(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 3) {
+        throw ShellWrongArgumentsException("fread takes exactly two arguments");
+    }
+
+    int32_t descriptor = ParseNumber(arguments[1], "descriptor");
+    int32_t length = ParseNumber(arguments[2], "length");
+
+    try {
+        m_ntfs.Read(descriptor, length, m_output);
+        m_output << std::endl;
+    }
+    catch (NtfsBadDescriptorException &exception) {
+        Fail("BAD DESCRIPTOR");
+    }
+}
+
+// done
+void Shell::CmdFwrite(std::vector<std::string> arguments)
+{
+    if (arguments.size() < 3) {
+        throw ShellWrongArgumentsException("fwrite takes the file descriptor and the text");
+    }
+
+    int32_t descriptor = ParseNumber(arguments[1], "descriptor");
+    std::stringstream text{JoinArguments(arguments, 2)};
+
+    try {
+        m_ntfs.Write(descriptor, text, static_cast<int32_t>(text.str().size()));
+        m_output << "OK" << std::endl;
+    }
+    catch (NtfsBadDescriptorException &exception) {
+        Fail("BAD DESCRIPTOR");
+    }
+}
+
+// done
+void Shell::CmdSeek(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 3) {
+        throw ShellWrongArgumentsException("seek takes exactly two arguments");
+    }
+
+    int32_t descriptor = ParseNumber(arguments[1], "descriptor");
+    int32_t position = ParseNumber(arguments[2], "position");
+
+    try {
+        m_ntfs.Seek(descriptor, position);
+        m_output << "OK" << std::endl;
+    }
+    catch (NtfsBadDescriptorException &exception) {
+        Fail("BAD DESCRIPTOR");
+    }
+}
+
+// done
+void Shell::CmdClose(std::vector<std::string> arguments)
+{
+    if (arguments.size() != 2) {
+        throw ShellWrongArgumentsException("close takes exactly one argument");
+    }
+
+    int32_t descriptor = ParseNumber(arguments[1], "descriptor");
+
+    try {
+        m_ntfs.Close(descriptor);
+        m_output << "OK" << std::endl;
+    }
+    catch (NtfsBadDescriptorException &exception) {
+        Fail("BAD DESCRIPTOR");
     }
 }
 
@@ -282,10 +538,10 @@ void Shell::CmdMkdir(std::vector<std::string> arguments)
         m_output << "OK" << std::endl;
     }
     catch (NtfsFileNotFoundException &exception) {
-        m_output << "PATH NOT FOUND" << std::endl;
+        Fail("PATH NOT FOUND");
     }
     catch (NtfsNodeAlreadyExistsException &exception) {
-        m_output << "EXISTS" << std::endl;
+        Fail("EXISTS");
     }
 }
 
@@ -301,10 +557,10 @@ void Shell::CmdRmdir(std::vector<std::string> arguments)
         m_output << "OK" << std::endl;
     }
     catch (NtfsFileNotFoundException &exception) {
-        m_output << "PATH NOT FOUND" << std::endl;
+        Fail("PATH NOT FOUND");
     }
     catch (NtfsDirectoryNotEmptyException &exception) {
-        m_output << "NOT EMPTY" << std::endl;
+        Fail("NOT EMPTY");
     }
 }
 
@@ -315,30 +571,55 @@ void Shell::CmdIncp(std::vector<std::string> arguments)
         throw ShellWrongArgumentsException("incp takes exactly two arguments");
     }
 
-    std::ifstream inFile{arguments[1]};
+    // a fifo without a writer would block the open, so it opens non blocking and is rejected below
+    int inFile = open(arguments[1].c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
 
-    if (!inFile.is_open()) {
-        m_output << "FILE NOT FOUND" << std::endl;
+    if (inFile < 0) {
+        Fail("FILE NOT FOUND");
         return;
     }
 
-    // compute the file size
-    inFile.seekg(0, std::ios::beg);
-    inFile.ignore(std::numeric_limits<std::streamsize>::max());
-    std::streamsize size = inFile.gcount();
-    inFile.clear();
-    inFile.seekg(0, std::ios_base::beg);
+    // take the file size from the file status
+    struct stat status{};
+
+    if (fstat(inFile, &status) < 0) {
+        std::string error{std::strerror(errno)};
+        close(inFile);
+        Fail("ERROR: can't get the status of the file: " + error);
+        return;
+    }
+
+    if (!S_ISREG(status.st_mode)) {
+        // the size of the other files isn't known in advance
+        close(inFile);
+        Fail("NOT A REGULAR FILE");
+        return;
+    }
+
+    if (status.st_size > INT32_MAX) {
+        close(inFile);
+        Fail("FILE TOO BIG");
+        return;
+    }
+
+    fcntl(inFile, F_SETFL, fcntl(inFile, F_GETFL) & ~O_NONBLOCK);
 
     try {
-        m_ntfs.Mkfile(arguments[2], inFile, size);
+        m_ntfs.Mkfile(arguments[2], inFile, static_cast<int32_t>(status.st_size));
         m_output << "OK" << std::endl;
     }
     catch (NtfsPathNotFoundException &exception) {
-        m_output << "PATH NOT FOUND" << std::endl;
+        Fail("PATH NOT FOUND");
     }
     catch (NtfsNodeAlreadyExistsException &exception) {
-        m_output << "EXISTS" << std::endl;
+        Fail("EXISTS");
+    }
+    catch (...) {
+        close(inFile);
+        throw;
     }
+
+    close(inFile);
 }
 
 // done
@@ -348,10 +629,10 @@ void Shell::CmdOutcp(std::vector<std::string> arguments)
         throw ShellWrongArgumentsException("outcp takes exactly two arguments");
     }
 
-    std::ofstream outFile{arguments[2]};
+    int outFile = open(arguments[2].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
-    if (!outFile.is_open()) {
-        m_output << "PATH NOT FOUND" << std::endl;
+    if (outFile < 0) {
+        Fail("PATH NOT FOUND");
         return;
     }
 
@@ -360,8 +641,14 @@ void Shell::CmdOutcp(std::vector<std::string> arguments)
         m_output << "OK" << std::endl;
     }
     catch (NtfsFileNotFoundException &exception) {
-        m_output << "FILE NOT FOUND" << std::endl;
+        Fail("FILE NOT FOUND");
+    }
+    catch (...) {
+        close(outFile);
+        throw;
     }
+
+    close(outFile);
 }
 
 // done
@@ -376,7 +663,7 @@ void Shell::CmdRm(std::vector<std::string> arguments)
         m_output << "OK" << std::endl;
     }
     catch (NtfsFileNotFoundException &exception) {
-        m_output << "FILE NOT FOUND" << std::endl;
+        Fail("FILE NOT FOUND");
     }
 }
 
@@ -392,13 +679,13 @@ void Shell::CmdMv(std::vector<std::string> arguments)
         m_output << "OK" << std::endl;
     }
     catch (NtfsFileNotFoundException &exception) {
-        m_output << "FILE NOT FOUND" << std::endl;
+        Fail("FILE NOT FOUND");
     }
     catch (NtfsPathNotFoundException &exception) {
-        m_output << "PATH NOT FOUND" << std::endl;
+        Fail("PATH NOT FOUND");
     }
     catch (NtfsNodeAlreadyExistsException &exception) {
-        m_output << "EXISTS" << std::endl;
+        Fail("EXISTS");
     }
 }
 
@@ -414,13 +701,13 @@ void Shell::CmdCp(std::vector<std::string> arguments)
         m_output << "OK" << std::endl;
     }
     catch (NtfsFileNotFoundException &exception) {
-        m_output << "FILE NOT FOUND" << std::endl;
+        Fail("FILE NOT FOUND");
     }
     catch (NtfsPathNotFoundException &exception) {
-        m_output << "PATH NOT FOUND" << std::endl;
+        Fail("PATH NOT FOUND");
     }
     catch (NtfsNodeAlreadyExistsException &exception) {
-        m_output << "EXISTS" << std::endl;
+        Fail("EXISTS");
     }
 }
 
@@ -463,15 +750,44 @@ void Shell::CmdBitmap(std::vector<std::string> arguments)
 // done
 void Shell::CmdCheck(std::vector<std::string> arguments)
 {
-    if (arguments.size() != 1) {
-        throw ShellWrongArgumentsException("check takes no arguments");
+    if (arguments.size() > 2
+        || (arguments.size() == 2 && arguments[1] != "--full" && arguments[1] != "--repair"
+            && arguments[1] != "--incremental")) {
+        throw ShellWrongArgumentsException("check takes no arguments, --full, --repair or --incremental");
+    }
+
+    if (arguments.size() == 2) {
+        if (!m_ntfsChecker.CheckBootRecord(m_output)) {
+            Fail("FAILED");
+            return;
+        }
+
+        bool consistent;
+
+        if (arguments[1] == "--full") {
+            consistent = m_ntfsChecker.CheckConsistency(m_output);
+        }
+        else if (arguments[1] == "--repair") {
+            consistent = m_ntfsChecker.RepairConsistency(m_output);
+        }
+        else {
+            consistent = m_ntfsChecker.CheckIncremental(m_output);
+        }
+
+        if (!consistent) {
+            Fail("FAILED");
+            return;
+        }
+
+        m_output << "OK" << std::endl;
+        return;
     }
 
     if (!m_ntfsChecker.CheckBootRecord(m_output)
         || !m_ntfsChecker.CheckNodeSizes(m_output)
         || !m_ntfsChecker.CheckFileDirectories(m_output)) {
 
-        m_output << "FAILED" << std::endl;
+        Fail("FAILED");
         return;
     }
 
@@ -488,4 +804,124 @@ void Shell::CmdBreak(std::vector<std::string> arguments)
     m_ntfsChecker.AddInconsistency();
 
     m_output << "OK" << std::endl;
-}
\ No newline at end of file
+}
+
+// done
+void Shell::CmdDefrag(std::vector<std::string> arguments)
+{
+    if (arguments.size() > 3 || (arguments.size() == 3 && arguments[1] != "all")) {
+        throw ShellWrongArgumentsException("defrag takes no arguments, the node path or the `all` switch and the budget");
+    }
+
+    auto progress = [this](const Node &node, size_t fragmentCount) {
+        m_output << node.GetName() << ": " << fragmentCount << " fragments -> 1" << std::endl;
+    };
+
+    if (arguments.size() == 2 && arguments[1] != "all") {
+        try {
+            m_ntfs.Defragment(arguments[1], progress);
+            m_output << "OK" << std::endl;
+        }
+        catch (NtfsNodeNotFoundException &exception) {
+            Fail("FILE NOT FOUND");
+        }
+
+        return;
+    }
+
+    int32_t budget = arguments.size() == 3 ? ParseNumber(arguments[2], "budget") : INT32_MAX;
+
+    int32_t moved = m_ntfs.Defragment(budget, progress);
+
+    m_output << "moved clusters: " << moved << std::endl;
+    m_output << "OK" << std::endl;
+}
+
+// done
+void Shell::CmdFragstat(std::vector<std::string> arguments)
+{
+    if (arguments.size() > 2) {
+        throw ShellWrongArgumentsException("fragstat takes one argument or no arguments");
+    }
+
+    int32_t topCount = arguments.size() == 2 ? ParseNumber(arguments[1], "count") : 10;
+
+    m_ntfsChecker.PrintFragmentationStats(m_output, static_cast<size_t>(topCount));
+}
+
+// done
+int32_t Shell::ParseNumber(const std::string &argument, const std::string &name)
+{
+    int32_t number;
+
+    std::stringstream numberStream{argument};
+    numberStream >> number;
+
+    if (numberStream.fail() || !numberStream.eof() || number < 0) {
+        throw ShellWrongArgumentsException(name + " is in bad format");
+    }
+
+    return number;
+}
+
+// done
+std::string Shell::JoinArguments(const std::vector<std::string> &arguments, size_t first)
+{
+    std::string text;
+
+    for (size_t i = first; i < arguments.size(); i++) {
+        if (i != first) {
+            text += " ";
+        }
+
+        text += arguments[i];
+    }
+
+    return text;
+}
+
+// done
+void Shell::CmdScrub(std::vector<std::string> arguments)
+{
+    if (arguments.size() < 2 || arguments.size() > 3
+        || (arguments[1] != "start" && arguments.size() != 2)) {
+        throw ShellWrongArgumentsException("scrub takes start [rate], stop or status");
+    }
+
+    if (arguments[1] == "start") {
+        int64_t rate = arguments.size() == 3 ? ParseSize(arguments[2]) : SCRUB_DEFAULT_RATE;
+
+        if (rate <= 0) {
+            throw ShellWrongArgumentsException("the rate must be positive");
+        }
+
+        m_scrubber.Start(rate);
+        m_output << "OK" << std::endl;
+    }
+    else if (arguments[1] == "stop") {
+        m_scrubber.Stop();
+        m_output << "OK" << std::endl;
+    }
+    else if (arguments[1] == "status") {
+        auto status = m_scrubber.GetStatus();
+
+        m_output
+            << "running: " << (status.running ? "YES" : "NO")
+            << ", rate: " << status.rate << " B/s"
+            << ", passes: " << status.passes
+            << std::endl
+            << "mft items: " << status.checkedItems << "/" << status.mftItemCount
+            << ", clusters: " << status.checkedClusters << "/" << status.clusterCount
+            << ", read: " << status.bytesRead << " B"
+            << std::endl
+            << "errors: " << status.errors
+            << std::endl;
+
+        if (!status.lastError.empty()) {
+            m_output << "last error: " << status.lastError << std::endl;
+        }
+    }
+    else {
+        throw ShellWrongArgumentsException("scrub takes start [rate], stop or status");
+    }
+}
@@ -7,9 +7,11 @@
 #include <functional>
 #include <regex>
 #include <unordered_map>
+#include <memory>
 
 #include "Ntfs.h"
 #include "NtfsChecker.h"
+#include "Scrubber.h"
 
 /**
  * Simple shell to control the ntfs.
@@ -26,11 +28,51 @@ public:
      */
     explicit Shell(Ntfs &ntfs, std::istream &input, std::ostream &output);
 
+    /**
+     * Initializes a new Shell bound to the given ntfs, which shares the scrubber with the other shells.
+     *
+     * @param ntfs The ntfs which the shell will operate on.
+     * @param scrubber The background scrubber of the ntfs.
+     * @param input The shell input stream.
+     * @param output The shell output stream.
+     */
+    Shell(Ntfs &ntfs, Scrubber &scrubber, std::istream &input, std::ostream &output);
+
     /**
      * Start reading the commands from input.
      */
     void Run();
 
+    /**
+     * Handle the command and write its output into the shell output.
+     *
+     * @param line The command line.
+     *
+     * @return False if the command failed, its failure message is given by GetError.
+     */
+    bool Handle(std::string line);
+
+    /**
+     * Get the failure message of the last handled command.
+     *
+     * @return The failure message, empty if the command succeeded.
+     */
+    const std::string &GetError() const;
+
+    /**
+     * Check whether the exit command was handled.
+     *
+     * @return True if the shell should terminate.
+     */
+    bool IsTerminated() const;
+
+    /**
+     * Get the string displayed as a command prompt.
+     *
+     * @return The prompt.
+     */
+    const std::string &GetPrompt() const;
+
 private:
     /**
      * The typedef for the Shell method, which will serve as a command handler.
@@ -50,6 +92,17 @@ private:
         {"info", &Shell::CmdInfo},
         {"ls", &Shell::CmdLs},
         {"cat", &Shell::CmdCat},
+        {"head", &Shell::CmdHead},
+        {"tail", &Shell::CmdTail},
+        {"read", &Shell::CmdRead},
+        {"write", &Shell::CmdWrite},
+        {"append", &Shell::CmdAppend},
+        {"truncate", &Shell::CmdTruncate},
+        {"open", &Shell::CmdOpen},
+        {"fread", &Shell::CmdFread},
+        {"fwrite", &Shell::CmdFwrite},
+        {"seek", &Shell::CmdSeek},
+        {"close", &Shell::CmdClose},
         {"mkdir", &Shell::CmdMkdir},
         {"rmdir", &Shell::CmdRmdir},
         {"incp", &Shell::CmdIncp},
@@ -62,6 +115,9 @@ private:
         {"bitmap", &Shell::CmdBitmap},
         {"check", &Shell::CmdCheck},
         {"break", &Shell::CmdBreak},
+        {"defrag", &Shell::CmdDefrag},
+        {"fragstat", &Shell::CmdFragstat},
+        {"scrub", &Shell::CmdScrub},
     };
 
     /**
@@ -94,17 +150,43 @@ private:
      */
     NtfsChecker m_ntfsChecker;
 
+    /**
+     * The background scrubber owned by this shell, null if the scrubber is shared.
+     */
+    std::unique_ptr<Scrubber> m_ownScrubber;
+
+    /**
+     * The background scrubber.
+     */
+    Scrubber &m_scrubber;
+
     /**
      * The shell termination condition.
      */
     bool m_shouldTerminate = false;
 
     /**
-     * Handle the command.
+     * The failure message of the last handled command.
+     */
+    std::string m_error;
+
+    /**
+     * Report the failure of the command, the message is written into the output too.
+     *
+     * @param message The failure message.
+     */
+    void Fail(const std::string &message);
+
+    /**
+     * Parse the size with an optional unit suffix K, M or G.
+     *
+     * @param text The size text.
      *
-     * @param command The command
+     * @throws ShellWrongArgumentsException When the size is in bad format or too big.
+     *
+     * @return The size in bytes.
      */
-    void Handle(std::string command);
+    int64_t ParseSize(const std::string &text);
 
     /**
      * Stop the shell.
@@ -169,6 +251,105 @@ private:
      */
     void CmdCat(std::vector<std::string> arguments);
 
+    /**
+     * Print the beginning of the file contents.
+     *
+     * @param arguments The command name, the file path and optionally the number of bytes.
+     */
+    void CmdHead(std::vector<std::string> arguments);
+
+    /**
+     * Print the end of the file contents.
+     *
+     * @param arguments The command name, the file path and optionally the number of bytes.
+     */
+    void CmdTail(std::vector<std::string> arguments);
+
+    /**
+     * Print the part of the file contents.
+     *
+     * @param arguments The command name, the file path, the offset and the number of bytes.
+     */
+    void CmdRead(std::vector<std::string> arguments);
+
+    /**
+     * Write the text into the file on the given offset.
+     *
+     * @param arguments The command name, the file path, the offset and the words of the text.
+     */
+    void CmdWrite(std::vector<std::string> arguments);
+
+    /**
+     * Append the text on the end of the file.
+     *
+     * @param arguments The command name, the file path and the words of the text.
+     */
+    void CmdAppend(std::vector<std::string> arguments);
+
+    /**
+     * Change the size of the file.
+     *
+     * @param arguments The command name, the file path and the new size.
+     */
+    void CmdTruncate(std::vector<std::string> arguments);
+
+    /**
+     * Open the file and print its descriptor.
+     *
+     * @param arguments The command name and the file path.
+     */
+    void CmdOpen(std::vector<std::string> arguments);
+
+    /**
+     * Print the data from the current position of the open file.
+     *
+     * @param arguments The command name, the file descriptor and the number of bytes.
+     */
+    void CmdFread(std::vector<std::string> arguments);
+
+    /**
+     * Write the text on the current position of the open file.
+     *
+     * @param arguments The command name, the file descriptor and the words of the text.
+     */
+    void CmdFwrite(std::vector<std::string> arguments);
+
+    /**
+     * Set the current position of the open file.
+     *
+     * @param arguments The command name, the file descriptor and the new position.
+     */
+    void CmdSeek(std::vector<std::string> arguments);
+
+    /**
+     * Close the open file.
+     *
+     * @param arguments The command name and the file descriptor.
+     */
+    void CmdClose(std::vector<std::string> arguments);
+
+    /**
+     * Join the arguments from the given index into a text separated by spaces.
+     *
+     * @param arguments The command arguments.
+     * @param first The index of the first argument to be joined.
+     *
+     * @return The joined text.
+     */
+    std::string JoinArguments(const std::vector<std::string> &arguments, size_t first);
+
+    /**
+     * Parse the non negative number argument.
+     *
+     * @param argument The argument.
+     * @param name The name of the argument used in the error message.
+     *
+     * @throws ShellWrongArgumentsException When the argument is not a non negative number.
+     *
+     * @return The parsed number.
+     */
+    int32_t ParseNumber(const std::string &argument, const std::string &name);
+
     /**
      * Make a new directory.
      *
@@ -184,7 +365,7 @@ private:
     void CmdRmdir(std::vector<std::string> arguments);
 
     /**
-     * Copy the file from outside into the partition.
+     * Copy the file from outside into the partition, only the regular files can be copied.
      *
      * @param arguments The command name, the source file path and the destination file path.
      */
@@ -241,8 +422,11 @@ private:
 
     /**
      * Check the partition consistency.
+     * With --full runs the single pass check, which cross-validates the bitmap too.
+     * With --repair runs the single pass check and repairs the found problems.
+     * With --incremental checks only the changes since the last successful check.
      *
-     * @param arguments Only the command name.
+     * @param arguments The command name and optionally --full, --repair or --incremental.
      */
     void CmdCheck(std::vector<std::string> arguments);
 
@@ -253,4 +437,27 @@ private:
      * @param arguments Only the command name.
      */
     void CmdBreak(std::vector<std::string> arguments);
+
+    /**
+     * Defragment the node or compact the whole data segment.
+     *
+     * @param arguments The command name and optionally the node path
+     *                  or the `all` switch followed by the max number of clusters to be moved.
+     */
+    void CmdDefrag(std::vector<std::string> arguments);
+
+    /**
+     * Print the fragmentation and space usage report.
+     *
+     * @param arguments The command name and optionally the number of the most fragmented nodes to be printed.
+     */
+    void CmdFragstat(std::vector<std::string> arguments);
+
+    /**
+     * Control the background scrubber, which validates the metadata and reads all allocated clusters.
+     *
+     * @param arguments The command name and `start` optionally followed by the max bytes read per second,
+     *                  `stop` or `status`.
+     */
+    void CmdScrub(std::vector<std::string> arguments);
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <sstream>
 #include <iomanip>
+#include <cstdio>
 
 #include "Text.h"
 
@@ -36,3 +37,96 @@ std::string Text::justifyR(std::string string, uint16_t width, char fillChar)
 
     return ss.str();
 }
+
+bool Text::isUtf8(const std::string &string)
+{
+    for (size_t i = 0; i < string.size(); i++) {
+        auto c = static_cast<unsigned char>(string[i]);
+
+        if (c < 0x80) {
+            continue;
+        }
+
+        size_t length = c >= 0xc2 && c <= 0xdf ? 2 : c >= 0xe0 && c <= 0xef ? 3 : c >= 0xf0 && c <= 0xf4 ? 4 : 0;
+
+        if (length == 0 || i + length > string.size()) {
+            return false;
+        }
+
+        for (size_t j = 1; j < length; j++) {
+            auto next = static_cast<unsigned char>(string[i + j]);
+
+            if ((next & 0xc0) != 0x80) {
+                return false;
+            }
+
+            // reject the overlong forms, the surrogates and the code points above the unicode range
+            if (j == 1 && ((c == 0xe0 && next < 0xa0) || (c == 0xed && next >= 0xa0)
+                || (c == 0xf0 && next < 0x90) || (c == 0xf4 && next >= 0x90))) {
+                return false;
+            }
+        }
+
+        i += length - 1;
+    }
+
+    return true;
+}
+
+std::string Text::jsonQuote(const std::string &string)
+{
+    std::string quoted{"\""};
+    quoted.reserve(string.size() + 2);
+
+    for (char character : string) {
+        auto c = static_cast<unsigned char>(character);
+
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += character;
+        }
+        else if (c == '\n') {
+            quoted += "\\n";
+        }
+        else if (c < 0x20 || c == 0x7f) {
+            char escaped[7];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        }
+        else {
+            // the utf-8 sequences are copied as they are
+            quoted += character;
+        }
+    }
+
+    quoted += '"';
+
+    return quoted;
+}
+
+std::string Text::base64(const std::string &data)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string encoded;
+    encoded.reserve((data.size() + 2) / 3 * 4);
+
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t group = static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << 16;
+
+        if (i + 1 < data.size()) {
+            group |= static_cast<uint32_t>(static_cast<unsigned char>(data[i + 1])) << 8;
+        }
+
+        if (i + 2 < data.size()) {
+            group |= static_cast<uint32_t>(static_cast<unsigned char>(data[i + 2]));
+        }
+
+        encoded += alphabet[(group >> 18) & 0x3f];
+        encoded += alphabet[(group >> 12) & 0x3f];
+        encoded += i + 1 < data.size() ? alphabet[(group >> 6) & 0x3f] : '=';
+        encoded += i + 2 < data.size() ? alphabet[group & 0x3f] : '=';
+    }
+
+    return encoded;
+}
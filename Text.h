@@ -41,6 +41,9 @@ public:
     static std::string hline(uint16_t width = 50, char lineChar = HORIZONTAL_LINE_CHAR);
     static std::string justifyL(std::string string, uint16_t width, char fillChar = ' ');
     static std::string justifyR(std::string string, uint16_t width, char fillChar = ' ');
+    static bool isUtf8(const std::string &string);
+    static std::string jsonQuote(const std::string &string);
+    static std::string base64(const std::string &data);
 };
 
 
@@ -0,0 +1,202 @@
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+namespace
+{
+    /**
+     * The pool of the current worker thread, null outside the pools.
+     */
+    thread_local const ThreadPool *currentPool{nullptr};
+
+    /**
+     * The index of the current worker thread within its pool.
+     */
+    thread_local size_t currentWorker{0};
+}
+
+// done
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    threadCount = std::max(threadCount, size_t{1});
+
+    for (size_t i = 0; i < threadCount; i++) {
+        m_queues.emplace_back(new WorkQueue);
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        m_threads.emplace_back(&ThreadPool::RunWorker, this, i);
+    }
+}
+
+// done
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_stopping = true;
+    }
+
+    m_taskQueued.notify_all();
+
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+// done
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &body)
+{
+    grain = std::max(grain, size_t{1});
+
+    std::vector<std::future<void>> futures;
+    std::atomic<size_t> remaining{0};
+
+    for (size_t rangeBegin = begin; rangeBegin < end; rangeBegin += grain) {
+        size_t rangeEnd = std::min(rangeBegin + grain, end);
+
+        remaining++;
+        futures.push_back(Submit([&body, &remaining, rangeBegin, rangeEnd]() {
+            try {
+                body(rangeBegin, rangeEnd);
+            }
+            catch (...) {
+                remaining--;
+                throw;
+            }
+
+            remaining--;
+        }));
+    }
+
+    WaitUntil([&remaining]() {
+        return remaining == 0;
+    });
+
+    // rethrow the first exception
+    for (auto &future : futures) {
+        future.get();
+    }
+}
+
+// done
+void ThreadPool::WaitUntil(const std::function<bool()> &done)
+{
+    size_t worker = GetCurrentWorker();
+
+    while (!done()) {
+        if (RunTask(worker)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_taskFinished.wait(lock, [this, &done]() {
+            return m_queued > 0 || done();
+        });
+    }
+}
+
+// done
+size_t ThreadPool::GetThreadCount() const
+{
+    return m_threads.size();
+}
+
+// done
+void ThreadPool::Push(std::function<void()> task)
+{
+    size_t worker = GetCurrentWorker();
+
+    if (worker == m_queues.size()) {
+        // spread the tasks submitted from outside over the queues
+        worker = m_nextQueue++ % m_queues.size();
+    }
+
+    {
+        // count the task first, so the counter never drops below the real number of queued tasks
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_queued++;
+    }
+
+    {
+        WorkQueue &queue = *m_queues[worker];
+        std::unique_lock<std::mutex> lock{queue.mutex};
+
+        queue.tasks.push_back(std::move(task));
+    }
+
+    m_taskQueued.notify_one();
+    m_taskFinished.notify_all();
+}
+
+// done
+bool ThreadPool::RunTask(size_t worker)
+{
+    std::function<void()> task;
+
+    // take the most recently queued task from the own queue
+    if (worker < m_queues.size()) {
+        WorkQueue &queue = *m_queues[worker];
+        std::unique_lock<std::mutex> lock{queue.mutex};
+
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+
+    // steal the oldest task from another queue
+    for (size_t i = 1; !task && i <= m_queues.size(); i++) {
+        WorkQueue &queue = *m_queues[(worker + i) % m_queues.size()];
+        std::unique_lock<std::mutex> lock{queue.mutex};
+
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    m_queued--;
+    task();
+
+    {
+        // the waiting thread may be between its check and the wait
+        std::unique_lock<std::mutex> lock{m_mutex};
+    }
+
+    m_taskFinished.notify_all();
+
+    return true;
+}
+
+// done
+void ThreadPool::RunWorker(size_t worker)
+{
+    currentPool = this;
+    currentWorker = worker;
+
+    while (true) {
+        if (RunTask(worker)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_taskQueued.wait(lock, [this]() {
+            return m_queued > 0 || m_stopping;
+        });
+
+        if (m_stopping && m_queued == 0) {
+            return;
+        }
+    }
+}
+
+// done
+size_t ThreadPool::GetCurrentWorker() const
+{
+    return currentPool == this ? currentWorker : m_queues.size();
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * Class ThreadPool runs the submitted tasks by a fixed number of worker threads.
+ * Every worker has its own queue, the tasks submitted by a worker go to its queue
+ * and the worker takes the most recent one, when its queue is empty it steals
+ * the oldest task from the other queues.
+ * The threads waiting for the tasks run the queued tasks meanwhile,
+ * so the tasks may wait for their subtasks without a deadlock.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * Initialize a new ThreadPool and start its workers.
+     *
+     * @param threadCount The number of worker threads, at least one is started.
+     */
+    explicit ThreadPool(size_t threadCount);
+
+    /**
+     * Run the remaining tasks and stop the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * Submit the task to be run by the pool.
+     *
+     * @param function The task.
+     *
+     * @return The future of the task result, it holds the exception thrown by the task.
+     */
+    template<typename Function>
+    auto Submit(Function function) -> std::future<decltype(function())>
+    {
+        typedef decltype(function()) Result;
+
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+        auto future = task->get_future();
+
+        Push([task]() {
+            (*task)();
+        });
+
+        return future;
+    }
+
+    /**
+     * Split the range of indexes into the subranges and run the body for each of them in parallel.
+     * The calling thread runs the tasks too, until all the subranges are done.
+     *
+     * @param begin The first index.
+     * @param end The index behind the last one.
+     * @param grain The max number of indexes in one subrange.
+     * @param body The function taking the subrange begin and end.
+     *
+     * @throws The first exception thrown by the body.
+     */
+    void ParallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &body);
+
+    /**
+     * Run the queued tasks in the calling thread until the condition holds.
+     * The condition is checked whenever a task finishes.
+     *
+     * @param done The condition.
+     */
+    void WaitUntil(const std::function<bool()> &done);
+
+    /**
+     * Get the number of worker threads.
+     *
+     * @return The number of worker threads.
+     */
+    size_t GetThreadCount() const;
+
+private:
+    /**
+     * The structure of the worker queue of tasks.
+     */
+    struct WorkQueue
+    {
+        std::mutex mutex;                               // the mutex of the queue
+        std::deque<std::function<void()>> tasks;        // the tasks
+    };
+
+    /**
+     * The queues of the workers.
+     */
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+
+    /**
+     * The worker threads.
+     */
+    std::vector<std::thread> m_threads;
+
+    /**
+     * The number of queued tasks not taken yet.
+     */
+    std::atomic<size_t> m_queued{0};
+
+    /**
+     * The queue for the next task submitted from outside the pool.
+     */
+    std::atomic<size_t> m_nextQueue{0};
+
+    /**
+     * Whether the workers should stop.
+     */
+    bool m_stopping{false};
+
+    /**
+     * The mutex for the waiting of the workers and the waiting threads.
+     */
+    std::mutex m_mutex;
+
+    /**
+     * The condition variable signalling a queued task.
+     */
+    std::condition_variable m_taskQueued;
+
+    /**
+     * The condition variable signalling a finished task.
+     */
+    std::condition_variable m_taskFinished;
+
+    /**
+     * Queue the task, into the queue of the current worker if it is called from one.
+     *
+     * @param task The task.
+     */
+    void Push(std::function<void()> task);
+
+    /**
+     * Take a task from the queue of the worker or steal it from another queue and run it.
+     *
+     * @param worker The index of the worker or the queue count for a thread outside the pool.
+     *
+     * @return True if a task was run, false if all the queues are empty.
+     */
+    bool RunTask(size_t worker);
+
+    /**
+     * Run the tasks until the pool is stopped.
+     *
+     * @param worker The index of the worker.
+     */
+    void RunWorker(size_t worker);
+
+    /**
+     * Get the index of the current worker of this pool.
+     *
+     * @return The worker index or the queue count if the current thread isn't the worker of this pool.
+     */
+    size_t GetCurrentWorker() const;
+};
@@ -0,0 +1,41 @@
+#include <algorithm>
+
+#include "TokenBucket.h"
+
+// done
+TokenBucket::TokenBucket(int64_t rate, int64_t capacity)
+    : m_rate(std::max(rate, int64_t{1})),
+      m_capacity(std::max(capacity, int64_t{1})),
+      m_tokens(static_cast<double>(m_capacity)),
+      m_lastRefill(std::chrono::steady_clock::now())
+{}
+
+// done
+std::chrono::nanoseconds TokenBucket::Consume(int64_t tokens)
+{
+    Refill();
+
+    m_tokens -= tokens;
+
+    if (m_tokens >= 0) {
+        return std::chrono::nanoseconds{0};
+    }
+
+    return std::chrono::nanoseconds{static_cast<int64_t>(-m_tokens * 1e9 / m_rate)};
+}
+
+// done
+int64_t TokenBucket::GetRate() const
+{
+    return m_rate;
+}
+
+// done
+void TokenBucket::Refill()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - m_lastRefill;
+
+    m_tokens = std::min(m_tokens + elapsed.count() * m_rate, static_cast<double>(m_capacity));
+    m_lastRefill = now;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+
+/**
+ * Class TokenBucket throttles the rate of some resource usage, e.g. the number of bytes read per second.
+ * The bucket is refilled continuously by the rate up to its capacity,
+ * a consumer takes the tokens and waits while the bucket is in debt.
+ */
+class TokenBucket
+{
+public:
+    /**
+     * Initialize a new full TokenBucket.
+     *
+     * @param rate The number of tokens added per second.
+     * @param capacity The max number of tokens kept in the bucket - the max burst.
+     */
+    TokenBucket(int64_t rate, int64_t capacity);
+
+    /**
+     * Take the tokens from the bucket, the bucket may get into debt.
+     *
+     * @param tokens The number of tokens.
+     *
+     * @return The time to wait until the debt is paid, zero if there is no debt.
+     */
+    std::chrono::nanoseconds Consume(int64_t tokens);
+
+    /**
+     * Get the rate of the bucket.
+     *
+     * @return The number of tokens added per second.
+     */
+    int64_t GetRate() const;
+
+private:
+    /**
+     * The number of tokens added per second.
+     */
+    int64_t m_rate;
+
+    /**
+     * The max number of tokens in the bucket.
+     */
+    int64_t m_capacity;
+
+    /**
+     * The current number of tokens, negative when in debt.
+     */
+    double m_tokens;
+
+    /**
+     * The time of the last refill.
+     */
+    std::chrono::steady_clock::time_point m_lastRefill;
+
+    /**
+     * Add the tokens for the time elapsed since the last refill.
+     */
+    void Refill();
+};
@@ -1,21 +1,31 @@
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <unistd.h>
 
 #include "Ntfs.h"
 #include "NtfsChecker.h"
 #include "NodeManager.h"
 #include "Shell.h"
+#include "ThreadPool.h"
+#include "Server.h"
+#include "Batch.h"
 
 /**
  * Prints the usage.
  */
 void print_usage() {
-    std::cout << "Usage: ntfs <partition_file_name>" << std::endl;
+    std::cout << "Usage: ntfs [--threads <count>] [--serve <socket> | --batch] <partition_file_name>" << std::endl;
 }
 
 /**
  * The main function of the program.
  * Initializes the Ntfs and the Shell and runs it.
+ * The thread pool has as many threads as there are cores, unless the count is given by --threads.
+ * With --serve the Shell isn't run, the clients connected to the given unix socket are served instead.
+ * With --batch the newline delimited json requests are read from the standard input instead of the commands.
  *
  * @param argc The number of program arguments.
  * @param argv The array of program arguments.
@@ -24,14 +34,73 @@ void print_usage() {
  */
 int main(int argc, char **argv)
 {
-    if (argc < 2) {
+    size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    std::string socketPath;
+    bool batch{false};
+    int argument = 1;
+
+    while (argument < argc && std::string{argv[argument]}.compare(0, 2, "--") == 0) {
+        std::string option{argv[argument]};
+
+        if (option == "--batch") {
+            batch = true;
+            argument++;
+            continue;
+        }
+
+        if (argument + 1 >= argc) {
+            print_usage();
+            return 0;
+        }
+
+        if (option == "--threads") {
+            std::stringstream countStream{argv[argument + 1]};
+            int count{0};
+
+            countStream >> count;
+
+            if (countStream.fail() || !countStream.eof() || count < 1) {
+                print_usage();
+                return 0;
+            }
+
+            threadCount = static_cast<size_t>(count);
+        }
+        else if (option == "--serve") {
+            socketPath = argv[argument + 1];
+        }
+        else {
+            print_usage();
+            return 0;
+        }
+
+        argument += 2;
+    }
+
+    if (argc <= argument || (batch && !socketPath.empty())) {
         print_usage();
         return 0;
     }
 
     try {
+        ThreadPool threadPool{threadCount};
+        Ntfs ntfs{argv[argument], threadPool};
+
+        if (!socketPath.empty()) {
+            // the sessions have their own pool, see the Server
+            ThreadPool sessionPool{threadCount};
+            Server server{ntfs, sessionPool, socketPath};
+
+            server.Run();
+            return 0;
+        }
+
+        if (batch) {
+            Batch batchShell{ntfs, STDIN_FILENO, STDOUT_FILENO};
 
-        Ntfs ntfs{argv[1]};
+            batchShell.Run();
+            return 0;
+        }
 
         Shell shell{ntfs, std::cin, std::cout};
         shell.Run();